@@ -0,0 +1,174 @@
+/*
+ * ADC oversampling and decimation
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Define ADC_OVER_BITS (1 ~ 6 extra bits) before include, setup prescaler and
+ *   voltage refrence with adc_set() (not ADC_FREE_RUN) and forward the ADC
+ *   interrupt:
+ *
+ *     ISR_ADC() {adc_over_isr();}
+ *
+ *   ISR adds 4^ADC_OVER_BITS conversions in a 16bit (bits <= 3) or 32bit
+ *   accumulator and decimates by right shift of ADC_OVER_BITS, so result has
+ *   10+ADC_OVER_BITS bits without any division.
+ *
+ *   adc_over_run(): ADC free running, new result on every adc_over_ready().
+ *   adc_over_sleep_read(): blocking read, every conversion is started by ADC
+ *   noise reduction sleep (SLEEP_ADC), so CPU is stopped while converting.
+ *
+ *   Extra bits need some noise (at least 1 LSB) on the input, else all
+ *   samples are equal and decimation gives no new information.
+ */
+
+
+#ifndef _ADC_OVER_H_
+#define _ADC_OVER_H_ 1
+
+
+#include "util.h"
+#include "adc.h"
+#include "sleep.h"
+
+
+/* ADC oversampling extra bits (1 ~ 6) */
+#ifndef ADC_OVER_BITS
+#define ADC_OVER_BITS  2
+#endif /* ADC_OVER_BITS */
+#if ADC_OVER_BITS < 1 || ADC_OVER_BITS > 6
+#error "ADC_OVER_BITS must be 1 ~ 6"
+#endif
+
+#define ADC_OVER_SAMPLES  (1 << (2*ADC_OVER_BITS))  /* conversions per result (4^bits) */
+#define ADC_OVER_RESULT_BITS  (10+ADC_OVER_BITS)    /* result bits */
+
+/* result rate (Hz) for ADC prescaler 2 ~ 128 (13 ADC clocks per conversion) */
+#define ADC_OVER_RATE(div)  (F_CPU/(div)/13/ADC_OVER_SAMPLES)
+
+#if ADC_OVER_BITS <= 3
+typedef uint16_t adc_over_acc_t;  /* 64*1023 fits in 16bit */
+typedef uint8_t adc_over_cnt_t;
+#else /* ADC_OVER_BITS > 3 */
+typedef uint32_t adc_over_acc_t;
+typedef uint16_t adc_over_cnt_t;
+#endif /* ADC_OVER_BITS */
+
+
+/* ADC oversampling state */
+static struct {
+    adc_over_acc_t acc;        /* accumulator (ISR only) */
+    adc_over_cnt_t count;      /* accumulated conversions (ISR only) */
+    volatile uint16_t result;  /* last decimated result */
+    volatile uint8_t ready;    /* new result */
+} _adc_over __attribute__((unused));
+
+
+/* ADC oversampling macros */
+#define adc_over_ready()  (_adc_over.ready)                            /* new result is ready */
+#define adc_over_rate()   ((F_CPU/13/ADC_OVER_SAMPLES) >> (mis(ADCSRA, 7)? mis(ADCSRA, 7): 1))  /* result rate (Hz) by current ADC prescaler */
+#define adc_over_di()     cmi(ADCSRA, b1(ADIE)|ADC_FREE_RUN)          /* stop */
+
+
+/* reset accumulator (ADC interrupt off) */
+static inline void _adc_over_reset(uint8_t cnl) {
+    cmi(ADCSRA, b1(ADIE)|ADC_FREE_RUN);
+    wait_clear_bit(ADCSRA, ADSC);  /* running conversion */
+    out(ADCSRA, in(ADCSRA) | b1(ADIF));  /* clear old complete flag */
+    adc_input(cnl);
+    _adc_over.acc = 0;
+    _adc_over.count = 0;
+    _adc_over.ready = 0;
+}
+
+/* start continuous oversampling of channel (free running) */
+static inline void adc_over_run(uint8_t cnl) {
+    _adc_over_reset(cnl);
+#ifdef ADATE
+    cmi(SFIOR, b1(ADTS2)|b1(ADTS1)|b1(ADTS0));
+#endif /* ADATE */
+    smi(ADCSRA, b1(ADEN)|b1(ADIE)|ADC_FREE_RUN|b1(ADSC));
+}
+
+/* read last result and clear ready */
+static inline uint16_t adc_over_get(void) {
+    uint16_t r;
+    uint8_t s = in(SREG);
+
+    cli();
+    r = _adc_over.result;
+    _adc_over.ready = 0;
+    out(SREG, s);
+    return r;
+}
+
+/* blocking read of channel with ADC noise reduction sleep (interrupts must be enabled) */
+static inline uint16_t adc_over_sleep_read(uint8_t cnl) {
+    _adc_over_reset(cnl);
+    smi(ADCSRA, b1(ADEN)|b1(ADIE));
+    sleep_set(SLEEP_ADC);
+    while (!_adc_over.ready)
+        sleep_one();  /* sleep starts conversion, ADC interrupt wakes up */
+    cbi(ADCSRA, ADIE);
+    return adc_over_get();
+}
+
+/* ADC oversampling handler (call from ISR_ADC) */
+static inline void adc_over_isr(void) {
+    adc_over_acc_t acc = _adc_over.acc+adc_data();
+    adc_over_cnt_t count = _adc_over.count+1;
+
+    if (count >= ADC_OVER_SAMPLES) {
+        _adc_over.result = acc >> ADC_OVER_BITS;
+        _adc_over.ready = 1;
+        acc = 0;
+        count = 0;
+    }
+    _adc_over.acc = acc;
+    _adc_over.count = count;
+}
+
+
+#ifdef _ADC_OVER_H_TEST_
+
+/* 12bit ADC0 (ADC_OVER_BITS=2): PORTB,PORTC show free running result and PORTD,PORTA show sleep read */
+
+int main(void) {
+    uint16_t r;
+
+    DDRA = ~0;
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    adc_set(ADC_CK_DIV128 | ADC_VREF_AVCC);
+    adc_en();
+    sei();
+
+    for (;;) {
+        adc_over_run(ADC0);
+        while (!adc_over_ready());
+        r = adc_over_get();
+        PORTB = r;
+        PORTC = r >> 8;
+
+        r = adc_over_sleep_read(ADC0);
+        PORTD = r;
+        PORTA = r >> 8;
+    }
+
+    return 0;
+}
+
+ISR_ADC() {
+    adc_over_isr();
+}
+
+#endif /* _ADC_OVER_H_TEST_ */
+
+
+#endif /* _ADC_OVER_H_ */
@@ -0,0 +1,195 @@
+/*
+ * Timer triggered fixed rate ADC sampling
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Setup voltage refrence with adc_set() and forward the ADC interrupt:
+ *
+ *     ISR_ADC() {adc_sample_isr();}
+ *
+ *   adc_sample_at(hz, channel, buffer, n) sets timer1 CTC (or timer0 CTC when
+ *   ADC_SAMPLE_TIMER is 0) at hz, ADC auto trigger by timer compare match and
+ *   ADC prescaler (slowest ADC clock which converts in one period), then fills
+ *   buffer with n samples from ISR and stops (adc_sample_done).
+ *
+ *   ATmega16/32 (ADATE): timer compare match starts every conversion, so
+ *   sample time has no software jitter. ISR only clears compare flag (needed
+ *   for next trigger) and stores result.
+ *
+ *   ATmega8 (ADFR): ADC is free running and ISR stores only the first result
+ *   after each timer compare match (OCF1A gate), so jitter is up to one
+ *   conversion time (13 ADC clocks). Timer0 has no CTC on ATmega8, so always
+ *   timer1 is used.
+ */
+
+
+#ifndef _ADC_SAMPLE_H_
+#define _ADC_SAMPLE_H_ 1
+
+
+#include "util.h"
+#include "adc.h"
+#include "timer0.h"
+#include "timer1.h"
+
+
+/* ADC sample timer (1: timer1 - 0: timer0) */
+#ifndef ADC_SAMPLE_TIMER
+#define ADC_SAMPLE_TIMER  1
+#endif /* ADC_SAMPLE_TIMER */
+#if !defined(ADATE) || !defined(OCR0)
+#undef ADC_SAMPLE_TIMER
+#define ADC_SAMPLE_TIMER  1
+#endif
+
+
+/* ADC sample state */
+static struct {
+    uint16_t *buf;            /* sample buffer */
+    uint16_t size;            /* samples to take */
+    volatile uint16_t count;  /* taken samples */
+} _adc_sample __attribute__((unused));
+
+
+/* ADC sample macros */
+#define adc_sample_done()   (!bis(ADCSRA, ADIE))  /* buffer is filled */
+#define adc_sample_count()  ({uint16_t _c; uint8_t _s = in(SREG); cli(); _c = _adc_sample.count; out(SREG, _s); _c;})  /* taken samples */
+
+
+/* stop sampling */
+static inline void adc_sample_stop(void) {
+    cmi(ADCSRA, b1(ADIE)|ADC_FREE_RUN);
+#if ADC_SAMPLE_TIMER
+    timer1_di();
+#else /* !ADC_SAMPLE_TIMER */
+    timer0_di();
+#endif /* ADC_SAMPLE_TIMER */
+}
+
+/* start sampling of channel at hz into buffer of n samples, return 0 if hz is out of range */
+static inline uint8_t adc_sample_at(uint32_t hz, uint8_t cnl, uint16_t *buf, uint16_t n) {
+    static const uint16_t tdiv[] = {1, 8, 64, 256, 1024};
+    uint32_t top = 0;
+    uint8_t i, adps;
+
+    if (!hz)
+        return 0;
+
+    /* timer prescaler: first one with top in range */
+    for (i = 0; i < sizeof(tdiv)/sizeof(tdiv[0]); i++) {
+        top = F_CPU/tdiv[i]/hz;
+#if ADC_SAMPLE_TIMER
+        if (top <= 0x10000)
+#else /* !ADC_SAMPLE_TIMER */
+        if (top <= 0x100)
+#endif /* ADC_SAMPLE_TIMER */
+            break;
+    }
+    if (i >= sizeof(tdiv)/sizeof(tdiv[0]) || top < 2)
+        return 0;
+
+    /* ADC prescaler: slowest clock with 14 ADC clocks in one period */
+    for (adps = 7; adps; adps--) {
+        if (F_CPU/((uint32_t)1 << adps) >= hz*14)
+            break;
+    }
+    if (!adps)
+        return 0;
+
+    adc_sample_stop();
+    _adc_sample.buf = buf;
+    _adc_sample.size = n;
+    _adc_sample.count = 0;
+    adc_input(cnl);
+
+#ifdef ADATE
+#if ADC_SAMPLE_TIMER
+    cmi(SFIOR, b1(ADTS2)|b1(ADTS1)|b1(ADTS0));
+    smi(SFIOR, ADC_TRIGGER_TIMER1_CMPB>>16);
+    timer1_value(0);
+    timer1_compareA(top-1);
+    timer1_compareB(top-1);
+    out(TIFR, b1(OCF1B));
+    out(ADCSRA, b1(ADEN)|b1(ADATE)|b1(ADIE)|adps);
+    timer1_set(TIMER1_MODE_CTC_CMPA | (i+1));  /* CS12:0 = 1 ~ 5 */
+#else /* !ADC_SAMPLE_TIMER */
+    cmi(SFIOR, b1(ADTS2)|b1(ADTS1)|b1(ADTS0));
+    smi(SFIOR, ADC_TRIGGER_TIMER0_CMP>>16);
+    timer0_value(0);
+    timer0_compare(top-1);
+    out(TIFR, b1(OCF0));
+    out(ADCSRA, b1(ADEN)|b1(ADATE)|b1(ADIE)|adps);
+    timer0_set(TIMER0_MODE_CTC | (i+1));  /* CS02:0 = 1 ~ 5 */
+#endif /* ADC_SAMPLE_TIMER */
+#else /* !ADATE */
+    timer1_value(0);
+    timer1_compareA(top-1);
+    out(TIFR, b1(OCF1A));
+    out(ADCSRA, b1(ADEN)|b1(ADFR)|b1(ADSC)|b1(ADIE)|adps);
+    timer1_set(TIMER1_MODE_CTC_CMPA | (i+1));  /* CS12:0 = 1 ~ 5 */
+#endif /* ADATE */
+    return 1;
+}
+
+/* ADC sample handler (call from ISR_ADC) */
+static inline void adc_sample_isr(void) {
+    uint16_t count = _adc_sample.count;
+
+#ifdef ADATE
+#if ADC_SAMPLE_TIMER
+    out(TIFR, b1(OCF1B));  /* clear trigger flag for next trigger */
+#else /* !ADC_SAMPLE_TIMER */
+    out(TIFR, b1(OCF0));   /* clear trigger flag for next trigger */
+#endif /* ADC_SAMPLE_TIMER */
+#else /* !ADATE */
+    if (bic(TIFR, OCF1A))
+        return;  /* no timer period since last sample */
+    out(TIFR, b1(OCF1A));
+#endif /* ADATE */
+
+    _adc_sample.buf[count++] = adc_data();
+    _adc_sample.count = count;
+    if (count >= _adc_sample.size)
+        adc_sample_stop();
+}
+
+
+#ifdef _ADC_SAMPLE_H_TEST_
+
+/* sample ADC0 at 1KHz, PORTB toggles on each filled buffer (100ms period) */
+/* PORTC shows timer1 phase at ISR entry (constant phase: no trigger jitter) */
+
+uint16_t buf[100];
+
+int main(void) {
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    adc_set(ADC_VREF_AVCC);
+    sei();
+
+    for (;;) {
+        adc_sample_at(1000, ADC0, buf, sizeof(buf)/sizeof(buf[0]));
+        while (!adc_sample_done());
+        PORTB ^= 1;
+    }
+
+    return 0;
+}
+
+ISR_ADC() {
+    PORTC = in(TCNT1) >> 4;
+    adc_sample_isr();
+}
+
+#endif /* _ADC_SAMPLE_H_TEST_ */
+
+
+#endif /* _ADC_SAMPLE_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Interrupt driven ADC scan sequencer
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Setup prescaler and voltage refrence with adc_set() (not ADC_FREE_RUN and
+ *   not ADC_START), enable with adc_en(), call adc_scan_en() with a channel
+ *   list (ADCx and ADC_DIFxx_* entries) and forward the ADC interrupt:
+ *
+ *     ISR_ADC() {adc_scan_isr();}
+ *
+ *   ISR converts channels of list one after other and writes results to the
+ *   back frame. On end of list the back frame is published as front frame
+ *   (adc_scan_ready) and scan restarts. Main reads all channels of front frame
+ *   (adc_scan_frame) as one coherent snapshot and then calls adc_scan_release.
+ *   Until release, ISR does not touch front frame; completed frames in this
+ *   time are dropped (adc_scan_dropped).
+ *
+ *   Differential gain channels need settling after MUX change, so when list
+ *   switches to a gain channel the first conversion is discarded (datasheet
+ *   rule). Differential results are raw 10bit two's complement.
+ */
+
+
+#ifndef _ADC_SCAN_H_
+#define _ADC_SCAN_H_ 1
+
+
+#include "util.h"
+#include "adc.h"
+
+
+/* ADC scan options */
+#ifndef ADC_SCAN_MAX
+#define ADC_SCAN_MAX  8  /* max channels in list */
+#endif /* ADC_SCAN_MAX */
+
+/* ADC channel is differential gain channel (MUX change needs one discarded conversion) */
+#ifdef MUX4
+#define adc_scan_gain(cnl)  ((cnl) >= ADC_DIF00_10 && (cnl) <= ADC_DIF52)
+#else /* !MUX4 */
+#define adc_scan_gain(cnl)  (0)
+#endif /* MUX4 */
+
+
+/* ADC scan state */
+static struct {
+    const uint8_t *chn;               /* channel list */
+    uint8_t size;                     /* channels in list */
+    uint8_t idx;                      /* current channel (ISR only) */
+    uint8_t back;                     /* frame written by ISR (ISR only) */
+    uint8_t discard;                  /* next result is discarded (ISR only) */
+    volatile uint8_t ready;           /* front frame is published (1: owned by main) */
+    volatile uint8_t dropped;         /* dropped frames counter */
+    uint16_t frame[2][ADC_SCAN_MAX];  /* double buffered frames */
+} _adc_scan __attribute__((unused));
+
+
+/* ADC scan macros */
+#define adc_scan_ready()    (_adc_scan.ready)                                      /* new frame is ready */
+#define adc_scan_frame()    ((const uint16_t *)_adc_scan.frame[_adc_scan.back^1])  /* front frame (valid until adc_scan_release) */
+#define adc_scan_release()  {barrier(); _adc_scan.ready = 0;}                      /* front frame is readed */
+#define adc_scan_dropped()  (_adc_scan.dropped)                                    /* dropped frames counter */
+#define adc_scan_di()       cmi(ADCSRA, ADC_INT_COMPLETE)                          /* stop scan after current conversion */
+
+
+/* select channel and start conversion */
+static inline void _adc_scan_start(uint8_t cnl) {
+    out(ADMUX, (in(ADMUX) & ~(b1(4)|b1(MUX3)|b1(MUX2)|b1(MUX1)|b1(MUX0))) | cnl);
+    sbi(ADCSRA, ADSC);
+}
+
+/* start scan of n channels (n <= ADC_SCAN_MAX) */
+static inline void adc_scan_en(const uint8_t *chn, uint8_t n) {
+    _adc_scan.chn = chn;
+    _adc_scan.size = n;
+    _adc_scan.idx = 0;
+    _adc_scan.back = 0;
+    _adc_scan.ready = 0;
+    _adc_scan.dropped = 0;
+    _adc_scan.discard = adc_scan_gain(chn[0]);
+    adc_signal(ADC_INT_COMPLETE);
+    _adc_scan_start(chn[0]);
+}
+
+/* ADC scan handler (call from ISR_ADC) */
+static inline void adc_scan_isr(void) {
+    const uint8_t *chn = _adc_scan.chn;
+    uint8_t idx = _adc_scan.idx;
+    uint8_t cnl = chn[idx];
+    uint8_t next;
+
+    if (_adc_scan.discard) {
+        _adc_scan.discard = 0;
+        sbi(ADCSRA, ADSC);  /* same channel again */
+        return;
+    }
+
+    _adc_scan.frame[_adc_scan.back][idx] = adc_data();
+    if (++idx >= _adc_scan.size) {
+        idx = 0;
+        if (_adc_scan.ready) {
+            _adc_scan.dropped++;  /* main owns front frame, rewrite back frame */
+        } else {
+            _adc_scan.back ^= 1;
+            barrier();
+            _adc_scan.ready = 1;
+        }
+    }
+    _adc_scan.idx = idx;
+
+    next = chn[idx];
+    if (adc_scan_gain(next) && next != cnl)
+        _adc_scan.discard = 1;
+    _adc_scan_start(next);
+}
+
+
+#ifdef _ADC_SCAN_H_TEST_
+
+/* scan 4 channels, PORTB shows ADC0 and PORTC shows gain channel of same frame */
+
+const uint8_t chn[] = {ADC0, ADC1, ADC_DIF10_10, ADC2};
+
+int main(void) {
+    const uint16_t *f;
+
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    adc_set(ADC_CK_DIV128 | ADC_VREF_AVCC);
+    adc_en();
+    adc_scan_en(chn, sizeof(chn));
+    sei();
+
+    for (;;) {
+        if (adc_scan_ready()) {
+            f = adc_scan_frame();
+            PORTB = f[0] >> 2;
+            PORTC = f[2] >> 2;
+            adc_scan_release();
+        }
+    }
+
+    return 0;
+}
+
+ISR_ADC() {
+    adc_scan_isr();
+}
+
+#endif /* _ADC_SCAN_H_TEST_ */
+
+
+#endif /* _ADC_SCAN_H_ */
@@ -1,8 +1,8 @@
 /*
  * All header files
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 
@@ -14,20 +14,42 @@
 
 #include "acmp.h"
 #include "adc.h"
+#include "adc_over.h"
+#include "adc_sample.h"
+#include "adc_scan.h"
+#include "boot.h"
+#include "capture.h"
 #include "eep.h"
+#include "eep_buf.h"
+#include "eep_cache.h"
+#include "eep_rec.h"
+#include "flash_log.h"
+#include "freq.h"
 #include "fuse.h"
 #include "irq.h"
 #include "other.h"
 #include "pio.h"
+#include "pm.h"
+#include "pt.h"
+#include "sched.h"
+#include "sd.h"
 #include "sleep.h"
 #include "spi.h"
+#include "spi_master.h"
+#include "spi_slave.h"
 #include "spm.h"
+#include "tick.h"
 #include "timer0.h"
 #include "timer1.h"
 #include "timer2.h"
 #include "twi.h"
+#include "twi_master.h"
+#include "twi_slave.h"
 #include "usart.h"
+#include "usart_buf.h"
 #include "wdt.h"
+#include "wdt_sup.h"
+#include "wheel.h"
 
 
 #endif /* _ALL_H_ */
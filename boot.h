@@ -0,0 +1,267 @@
+/*
+ * USART bootloader with read while write
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call boot_run() from main of bootloader program and link it to boot
+ *   section (e.g. ATmega32 with 2KB boot: -Wl,--section-start=.text=0x7800
+ *   and BOOTRST fuse). SPM works only from boot section, so the helpers
+ *   which run SPM (_boot_spm, _boot_info) are BOOTMEM and noinline: they
+ *   stay in boot section even if boot_run() is inlined to .text of an
+ *   application.
+ *
+ *   At reset, if application is valid (length and CRC16 in last page of
+ *   application section match) and no 'S' comes in BOOT_WAIT ms, jumps to
+ *   application by irq_app(). Else runs protocol (8N1, BOOT_BAUD):
+ *
+ *     'S'                         -> 'S' SPM_PAGESIZE/2 (sync)
+ *     'W' adr_lo adr_hi page      -> '.' when page is written ('!' bad address)
+ *     'X' len_lo len_hi crc_lo crc_hi  -> 'K' if CRC16 (CCITT, 0xFFFF) of
+ *                                    application flash is same and stored, else 'F'
+ *     'G'                         -> 'G' and jump to application if valid
+ *
+ *   Two RAM page buffers: while one page is erased and written (RWW section
+ *   busy, about 8.5ms on ATmega32) the next page is received from NRWW boot
+ *   code. So host may send 2 pages before first '.', then one page per '.'.
+ *
+ *   115200 baud (11520 bytes/s): 131 bytes per 128 byte page = 11.4ms,
+ *   longer than erase and write, so flash is never the bottleneck: 16KB
+ *   (128 pages) takes 1.46s, line time of the data itself is 1.42s.
+ */
+
+
+#ifndef _BOOT_H_
+#define _BOOT_H_ 1
+
+
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "util.h"
+#include "irq.h"
+#include "spm.h"
+#include "usart.h"
+
+
+/* bootloader options */
+#ifndef BOOT_SIZE
+#define BOOT_SIZE  2048    /* boot section bytes (BOOTSZ fuses) */
+#endif /* BOOT_SIZE */
+#ifndef BOOT_BAUD
+#define BOOT_BAUD  115200  /* USART baud rate (double speed) */
+#endif /* BOOT_BAUD */
+#ifndef BOOT_WAIT
+#define BOOT_WAIT  500     /* ms to wait for host before start of valid application */
+#endif /* BOOT_WAIT */
+
+#define BOOT_START    (FLASHEND+1-BOOT_SIZE)    /* boot section address */
+#define BOOT_APP_END  (BOOT_START-SPM_PAGESIZE)  /* application max size (last page keeps length and CRC) */
+#define _BOOT_UBRR    ((F_CPU+BOOT_BAUD*4UL)/(BOOT_BAUD*8UL)-1)  /* UBRR for double speed */
+
+
+/* bootloader state */
+static struct {
+    uint8_t buf[2][SPM_PAGESIZE];  /* received pages */
+    uint16_t addr[2];              /* page address of buffer */
+    uint8_t full[2];               /* buffer waits for write */
+    uint8_t rx;                    /* buffer in receive */
+    uint8_t wr;                    /* buffer in write */
+    uint8_t spm;                   /* write state: 0 idle - 1 erase - 2 write */
+    uint8_t cmd;                   /* received command */
+    uint8_t arg[4];                /* command arguments */
+    uint16_t idx;                  /* received bytes of command */
+} _boot __attribute__((unused));
+
+
+/* send byte */
+static inline void BOOTMEM _boot_tx(uint8_t b) {
+    usart_empty_wait();
+    out(UDR, b);
+}
+
+/* CRC16 of application flash */
+static inline uint16_t BOOTMEM _boot_crc(uint16_t len) {
+    uint16_t i, crc = 0xFFFF;
+
+    for (i = 0; i < len; i++)
+        crc = _crc_ccitt_update(crc, pgm_read_byte(i));
+    return crc;
+}
+
+/* application has valid length and CRC */
+static inline uint8_t BOOTMEM _boot_app_valid(void) {
+    uint16_t len = pgm_read_word(BOOT_APP_END);
+
+    return len && len <= BOOT_APP_END && _boot_crc(len) == pgm_read_word(BOOT_APP_END+2);
+}
+
+/* jump to application */
+static inline void BOOTMEM _boot_app(void) {
+    usart_empty_wait();
+    usart_tx_wait();
+    out(UCSRB, 0);
+    irq_app();
+    ((void (*)(void))0)();
+}
+
+/* run one step of page write (never waits for flash) */
+static void BOOTMEM __attribute__((noinline, unused)) _boot_spm(void) {
+    uint8_t w = _boot.wr;
+    uint16_t adr = _boot.addr[w];
+    uint8_t i;
+
+    if (spm_busy())
+        return;
+    switch (_boot.spm) {
+    case 0:
+        if (!_boot.full[w])
+            return;
+        for (i = 0; i < SPM_PAGESIZE; i += 2)
+            spm_page_fill(adr+i, _boot.buf[w][i] | (_boot.buf[w][i+1] << 8));
+        spm_page_erase(adr);  /* page buffer is kept */
+        _boot.spm = 1;
+        break;
+    case 1:
+        spm_page_write(adr);
+        _boot.spm = 2;
+        break;
+    default:
+        spm_rww_read_en();
+        _boot.full[w] = 0;
+        _boot.wr = w^1;
+        _boot.spm = 0;
+        _boot_tx('.');
+        break;
+    }
+}
+
+/* wait to all pages written */
+static inline void BOOTMEM _boot_flush(void) {
+    while (_boot.full[0] || _boot.full[1] || _boot.spm || spm_busy())
+        _boot_spm();
+}
+
+/* store length and CRC in last application page */
+static void BOOTMEM __attribute__((noinline, unused)) _boot_info(uint16_t len, uint16_t crc) {
+    uint8_t i;
+
+    for (i = 0; i < SPM_PAGESIZE; i += 2)
+        spm_page_fill(BOOT_APP_END+i, (i == 0)? len: (i == 2)? crc: 0xFFFF);
+    spm_page_erase(BOOT_APP_END);
+    spm_wait();
+    spm_page_write(BOOT_APP_END);
+    spm_wait();
+    spm_rww_read_en();
+    spm_wait();
+}
+
+/* handle received byte */
+static inline void BOOTMEM _boot_rx(uint8_t b) {
+    uint8_t r = _boot.rx;
+    uint16_t n = _boot.idx++;
+    uint16_t len, crc;
+
+    if (!n) {
+        _boot.cmd = b;
+        if (b == 'S') {
+            _boot_tx('S');
+            _boot_tx(SPM_PAGESIZE/2);
+        } else if (b == 'G') {
+            _boot_flush();
+            _boot_tx('G');
+            if (_boot_app_valid())
+                _boot_app();
+        } else if (b == 'W' || b == 'X') {
+            return;
+        } else {
+            _boot_tx('?');
+        }
+        _boot.idx = 0;
+        return;
+    }
+
+    if (_boot.cmd == 'X') {
+        _boot.arg[n-1] = b;
+        if (n < 4)
+            return;
+        _boot.idx = 0;
+        _boot_flush();
+        len = _boot.arg[0] | (_boot.arg[1] << 8);
+        crc = _boot.arg[2] | (_boot.arg[3] << 8);
+        if (len && len <= BOOT_APP_END && _boot_crc(len) == crc) {
+            _boot_info(len, crc);
+            _boot_tx('K');
+        } else {
+            _boot_tx('F');
+        }
+        return;
+    }
+
+    /* 'W' */
+    if (n <= 2) {
+        _boot.arg[n-1] = b;
+        if (n == 2) {
+            while (_boot.full[r])
+                _boot_spm();  /* host sent more than 2 pages */
+            _boot.addr[r] = _boot.arg[0] | (_boot.arg[1] << 8);
+        }
+        return;
+    }
+    _boot.buf[r][n-3] = b;
+    if (n-3 < SPM_PAGESIZE-1)
+        return;
+    _boot.idx = 0;
+    if ((_boot.addr[r] & (SPM_PAGESIZE-1)) || _boot.addr[r] >= BOOT_APP_END) {
+        _boot_tx('!');
+        return;
+    }
+    _boot.full[r] = 1;
+    _boot.rx = r^1;
+}
+
+/* bootloader main (never returns) */
+static inline void BOOTMEM boot_run(void) {
+    uint32_t wait = (uint32_t)BOOT_WAIT*(F_CPU/1000)/16;  /* about 16 cycles per poll */
+
+    cli();
+    out(UBRRH, _BOOT_UBRR >> 8);
+    out(UBRRL, _BOOT_UBRR & 0xFF);
+    usart_set(USART_RX | USART_TX | USART_BAUD_DOUBLE | USART_REG_SELECT | USART_DATA_8BIT);
+    _boot.rx = _boot.wr = _boot.spm = 0;
+    _boot.full[0] = _boot.full[1] = 0;
+    _boot.idx = 0;
+
+    if (_boot_app_valid()) {
+        while (bic(UCSRA, RXC)) {
+            if (!--wait)
+                _boot_app();
+        }
+    }
+
+    for (;;) {
+        if (bis(UCSRA, RXC))
+            _boot_rx(in(UDR));
+        _boot_spm();
+    }
+}
+
+
+#ifdef _BOOT_H_TEST_
+
+/* bootloader program: link .text to BOOT_START and set BOOTRST fuse */
+
+int main(void) {
+    boot_run();
+
+    return 0;
+}
+
+#endif /* _BOOT_H_TEST_ */
+
+
+#endif /* _BOOT_H_ */
@@ -0,0 +1,245 @@
+/*
+ * Input capture period and frequency measurement
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Forward timer1 capture and overflow interrupts, then start with
+ *   capture_en(n, edge) (period and frequency) or capture_duty_en(n, edge)
+ *   (also high time, ICES1 toggles each capture), edge is
+ *   TIMER1_CAPTURE_RISING_EDGE or TIMER1_CAPTURE_FALLING_EDGE (start of
+ *   period) with TIMER1_CAPTURE_NOISE_CANCELER:
+ *
+ *     ISR_TIMER1_CAPT() {capture_isr();}
+ *     ISR_TIMER1_OVF() {capture_ovf_isr();}
+ *
+ *   Timer1 runs free at F_CPU/CAPTURE_DIV, overflow ISR counts upper 16bit
+ *   so captures are 32bit. Race: when capture and overflow are pending
+ *   together, capture ISR runs first (higher priority), so it adds the
+ *   pending overflow if ICR1 is in lower half (captured after overflow).
+ *
+ *   Each result is average of n periods (one division, resolution is one
+ *   timer tick over n periods): capture_ready(), then capture_period()
+ *   (ticks), capture_freq() (Hz), capture_duty() (0 ~ 1).
+ *
+ *   capture_src_acmp() takes analog comparator output as capture source
+ *   (ACMP_CAPTURE, comparator must be enabled), capture_src_icp() the ICP1 pin.
+ *   State is static in header: forward ISRs and read results in one source
+ *   file.
+ *
+ *   Range (CAPTURE_DIV 1): period up to 2^32 ticks (268s at 16MHz, n*period
+ *   for average). Capture ISR takes about 100 cycles, so edges must be at
+ *   least 100 cycles apart (F_CPU/100 for period, both edges for duty);
+ *   faster signals need a prescaler or the counter of freq.h.
+ */
+
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_ 1
+
+
+#include "util.h"
+#include "timer1.h"
+
+
+/* capture timer prescaler */
+#ifndef CAPTURE_DIV
+#define CAPTURE_DIV  1  /* 1, 8, 64, 256 or 1024 */
+#endif /* CAPTURE_DIV */
+
+#if CAPTURE_DIV == 1
+#define _CAPTURE_CK  TIMER1_CK_DIV1
+#elif CAPTURE_DIV == 8
+#define _CAPTURE_CK  TIMER1_CK_DIV8
+#elif CAPTURE_DIV == 64
+#define _CAPTURE_CK  TIMER1_CK_DIV64
+#elif CAPTURE_DIV == 256
+#define _CAPTURE_CK  TIMER1_CK_DIV256
+#elif CAPTURE_DIV == 1024
+#define _CAPTURE_CK  TIMER1_CK_DIV1024
+#else
+#error "CAPTURE_DIV must be 1, 8, 64, 256 or 1024"
+#endif
+
+
+/* capture state */
+static struct {
+    volatile uint16_t ovf;  /* upper 16bit of timer1 */
+    uint32_t first;         /* first start edge of average */
+    uint32_t last;          /* last start edge */
+    uint32_t high;          /* high time sum of average */
+    uint8_t n;              /* periods to average */
+    uint8_t edges;          /* start edges of average */
+    uint8_t start;          /* ICES1 of start edge */
+    uint8_t duty;           /* capture both edges */
+    volatile uint32_t sum;  /* result: ticks of n periods */
+    volatile uint32_t hsum; /* result: high ticks of n periods */
+    volatile uint8_t ready; /* new result */
+} _capture __attribute__((unused));
+
+
+/* capture macros */
+#define capture_ready()     (_capture.ready)        /* new result */
+#define capture_src_icp()   cbi(ACSR, ACIC)          /* ICP1 pin is source */
+#define capture_src_acmp()  sbi(ACSR, ACIC)          /* analog comparator output is source */
+#define capture_di()        {cmi(TIMSK, TIMER1_INT_CAPT | TIMER1_INT_OVF); timer1_di();}  /* stop */
+#define capture_en(n, edge)       _capture_start(n, edge, 0)  /* measure period of n periods */
+#define capture_duty_en(n, edge)  _capture_start(n, edge, 1)  /* measure period and high time of n periods */
+
+
+/* start timer1 and capture */
+static inline void _capture_start(uint8_t n, uint8_t edge, uint8_t duty) {
+    cmi(TIMSK, TIMER1_INT_CAPT | TIMER1_INT_OVF);
+    _capture.ovf = 0;
+    _capture.n = n? n: 1;
+    _capture.edges = 0;
+    _capture.start = edge & b1(ICES1);
+    _capture.duty = duty;
+    _capture.ready = 0;
+    timer1_set(TIMER1_MODE_NORMAL | _CAPTURE_CK | edge);
+    timer1_value(0);
+    out(TIFR, b1(ICF1) | b1(TOV1));
+    timer1_signal(TIMER1_INT_CAPT | TIMER1_INT_OVF);
+}
+
+/* overflow handler */
+static inline void capture_ovf_isr(void) {
+    _capture.ovf++;
+}
+
+/* capture handler */
+static inline void capture_isr(void) {
+    uint16_t icr = in(ICR1), hi = _capture.ovf;
+    uint8_t edge = in(TCCR1B) & b1(ICES1);
+    uint32_t t;
+
+    if (bis(TIFR, TOV1) && icr < 0x8000)
+        hi++;  /* overflow before capture is pending */
+    t = ((uint32_t)hi << 16) | icr;
+
+    if (_capture.duty) {
+        ibi(TCCR1B, ICES1);
+        out(TIFR, b1(ICF1));  /* edge change may set flag */
+        if (edge != _capture.start) {
+            if (_capture.edges)
+                _capture.high += t-_capture.last;
+            return;
+        }
+    }
+
+    if (_capture.edges == _capture.n) {
+        _capture.sum = t-_capture.first;
+        _capture.hsum = _capture.high;
+        _capture.ready = 1;
+        _capture.edges = 0;
+    }
+    if (!_capture.edges) {
+        _capture.first = t;
+        _capture.high = 0;
+    }
+    _capture.last = t;
+    _capture.edges++;
+}
+
+/* read last result (ticks of n periods and high ticks), clear ready */
+static inline void capture_read(uint32_t *sum, uint32_t *high) {
+    uint8_t s = in(SREG);
+
+    cli();
+    *sum = _capture.sum;
+    *high = _capture.hsum;
+    _capture.ready = 0;
+    out(SREG, s);
+}
+
+/* average period (ticks of F_CPU/CAPTURE_DIV) */
+static inline uint32_t capture_period(void) {
+    uint32_t sum, high;
+
+    capture_read(&sum, &high);
+    return (sum+_capture.n/2)/_capture.n;
+}
+
+/* average frequency (Hz) */
+static inline float capture_freq(void) {
+    uint32_t sum, high;
+
+    capture_read(&sum, &high);
+    return sum? (float)(F_CPU/CAPTURE_DIV)*_capture.n/sum: 0;
+}
+
+/* average duty cycle (0 ~ 1, capture_duty_en) */
+static inline float capture_duty(void) {
+    uint32_t sum, high;
+
+    capture_read(&sum, &high);
+    return sum? (float)high/sum: 0;
+}
+
+
+#ifdef _CAPTURE_H_TEST_
+
+/* test signal: timer0 CTC toggles OC0 (PB3), connect it to ICP1 (PD6), period of 2*div*(OCR0+1) cycles */
+/* sweeps OCR0 20 ~ 250 at DIV8 (edges at least 168 cycles apart), PORTA: OCR0, PORTC: measured period/16-1 */
+/* (same as PORTA), then slow step DIV1024 OCR0 255 (524288 cycles, 32bit by overflow), PORTA: 255, PORTC: */
+/* measured period/4096 (128), PORTB7: duty is 50% (+-1/128) */
+
+#include "timer0.h"
+
+ISR_TIMER1_CAPT() {
+    capture_isr();
+}
+
+ISR_TIMER1_OVF() {
+    capture_ovf_isr();
+}
+
+/* full average of 4 periods at new signal */
+static void measure(uint8_t ck, uint8_t ocr, uint32_t *p, uint32_t *h) {
+    timer0_set(TIMER0_MODE_CTC | TIMER0_OC0_TOGGLE | ck);
+    timer0_compare(ocr);
+    capture_read(p, h);
+    while (!capture_ready());
+    capture_read(p, h);
+    while (!capture_ready());  /* first average may start at old signal */
+    capture_read(p, h);
+    if (*h*2 > *p-*p/128 && *h*2 < *p+*p/128)
+        sbi(PORTB, 7);
+    else
+        cbi(PORTB, 7);
+}
+
+int main(void) {
+    uint32_t p, h;
+    uint8_t ocr;
+
+    DDRA = ~0;
+    DDRB = b1(7)|b1(3);
+    DDRC = ~0;
+
+    capture_src_icp();
+    capture_duty_en(4, TIMER1_CAPTURE_RISING_EDGE);
+    sei();
+
+    for (;;) {
+        for (ocr = 20; ocr <= 250; ocr += 10) {
+            measure(TIMER0_CK_DIV8, ocr, &p, &h);
+            PORTA = ocr;
+            PORTC = (p/4+8)/16-1;
+        }
+        measure(TIMER0_CK_DIV1024, 255, &p, &h);
+        PORTA = 255;
+        PORTC = (p/4+2048)/4096;
+    }
+
+    return 0;
+}
+
+#endif /* _CAPTURE_H_TEST_ */
+
+
+#endif /* _CAPTURE_H_ */
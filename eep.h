@@ -1,8 +1,8 @@
 /*
  * Eeprom memory
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -39,8 +39,8 @@
 #define eep_data(dta)    out(EEDR, dta)                 /* set data value */
 #define eep_data_get()   in(EEDR)                       /* readed value */
 #define eep_read()       sbi(EECR, EERE)                /* read data from address */
-#define eep_write()      smi(EECR, b1(EEMWE)|b1(EEWE))  /* write data to address */
-#define eep_wait()       wait_set_bit(EECR, EEWE)       /* wait to write enable */
+#define eep_write()      {uint8_t _s = in(SREG); cli(); sbi(EECR, EEMWE); sbi(EECR, EEWE); out(SREG, _s);}  /* write data to address (EEWE in 4 cycles after EEMWE) */
+#define eep_wait()       wait_clear_bit(EECR, EEWE)     /* wait to end of write */
 
 #define eep_write_byte(adr, vlu)  {eep_wait(); eep_addr((uint16_t)adr); eep_data(vlu); eep_write();}
 #define eep_read_byte(adr)        ({eep_wait(); eep_addr((uint16_t)adr); eep_read(); eep_data_get();})
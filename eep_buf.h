@@ -0,0 +1,204 @@
+/*
+ * Interrupt driven eeprom write queue
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call eep_buf_en() with an optional done callback and forward the eeprom
+ *   ready interrupt:
+ *
+ *     ISR_EEP_RDY() {eep_buf_isr();}
+ *
+ *   eep_write_block(addr, src, len) queues a block and returns at once, ISR
+ *   writes one byte per ready interrupt (about 8.5ms per byte), so main loop
+ *   is free. Bytes which already have the new value are skipped (no write
+ *   time and no wear), ISR compares up to EEP_BUF_SKIP bytes per interrupt.
+ *   src must be valid and unchanged until done callback (called from ISR
+ *   with src, keep it short) or until eep_buf_busy() is 0.
+ *
+ *   Eeprom reads in main loop while queue is busy must use
+ *   eep_buf_read_byte() (ISR uses EEAR too).
+ *
+ *   Brownout hook: on early power fail warning (e.g. analog comparator on
+ *   supply divider, see acmp.h) call eep_buf_flush(), which writes queued
+ *   bytes with interrupts off:
+ *
+ *     ISR_ACMP() {eep_buf_flush();}
+ */
+
+
+#ifndef _EEP_BUF_H_
+#define _EEP_BUF_H_ 1
+
+
+#include "util.h"
+#include "eep.h"
+
+
+/* eeprom queue options */
+#ifndef EEP_BUF_QUEUE
+#define EEP_BUF_QUEUE  4  /* queued blocks (power of two) */
+#endif /* EEP_BUF_QUEUE */
+#ifndef EEP_BUF_SKIP
+#define EEP_BUF_SKIP   8  /* max compared bytes per interrupt */
+#endif /* EEP_BUF_SKIP */
+
+
+/* eeprom queued block */
+typedef struct {
+    uint16_t addr;       /* eeprom address */
+    const uint8_t *src;  /* data */
+    uint16_t len;        /* length */
+} _eep_buf_blk_t;
+
+
+/* eeprom queue state */
+static struct {
+    FIFO(_eep_buf_blk_t, EEP_BUF_QUEUE) queue;  /* producer: main - consumer: ISR */
+    _eep_buf_blk_t blk;                         /* current block (ISR only) */
+    uint16_t idx;                               /* current byte (ISR only) */
+    uint8_t run;                                /* current block is valid (ISR only) */
+    volatile uint8_t busy;                      /* ISR is writing blocks */
+    volatile uint16_t written;                  /* written (not skipped) bytes */
+    void (*done)(const void *src);              /* block done callback (from ISR) or 0 */
+} _eep_buf __attribute__((unused));
+
+
+/* eeprom queue macros */
+#define eep_buf_en(fn)         {fifo_clear(_eep_buf.queue); _eep_buf.blk.len = 0; _eep_buf.idx = 0; _eep_buf.run = 0; _eep_buf.busy = 0; _eep_buf.written = 0; _eep_buf.done = (fn);}  /* reset queue and set done callback (or 0) */
+#define eep_buf_busy()         (_eep_buf.busy)                 /* blocks in queue or in write */
+#define eep_buf_wait()         {while (eep_buf_busy());}       /* wait to all blocks done */
+#define eep_buf_written()      ({uint16_t _w; uint8_t _s = in(SREG); cli(); _w = _eep_buf.written; out(SREG, _s); _w;})  /* written (not skipped) bytes */
+#define eep_buf_free()         fifo_space(_eep_buf.queue)      /* free block slots */
+
+
+/* queue block write, return 0 if queue is full */
+static inline uint8_t eep_write_block(uint16_t adr, const void *src, uint16_t len) {
+    _eep_buf_blk_t blk;
+
+    blk.addr = adr;
+    blk.src = (const uint8_t *)src;
+    blk.len = len;
+    if (!fifo_push(_eep_buf.queue, blk))
+        return 0;
+    if (!_eep_buf.busy) {
+        _eep_buf.busy = 1;
+        eep_signal(EEP_INT_RDY);  /* ready interrupt comes at once if eeprom is idle */
+    }
+    return 1;
+}
+
+/* read byte while ISR may write */
+static inline uint8_t eep_buf_read_byte(uint16_t adr) {
+    uint8_t b, s = in(SREG);
+
+    for (;;) {
+        eep_wait();  /* interrupts as caller, ISR may start next write */
+        cli();
+        if (bic(EECR, EEWE))
+            break;
+        out(SREG, s);
+    }
+    eep_addr(adr);
+    eep_read();
+    b = eep_data_get();
+    out(SREG, s);
+    return b;
+}
+
+/* eeprom queue handler (call from ISR_EEP_RDY) */
+static inline void eep_buf_isr(void) {
+    _eep_buf_blk_t *blk = &_eep_buf.blk;
+    uint8_t n, d;
+
+    for (n = 0; n < EEP_BUF_SKIP; n++) {
+        if (_eep_buf.idx >= blk->len) {
+            if (_eep_buf.run && _eep_buf.done)
+                _eep_buf.done(blk->src);
+            _eep_buf.run = 0;
+            if (!fifo_pop(_eep_buf.queue, blk)) {
+                cbi(EECR, EERIE);
+                _eep_buf.busy = 0;
+                return;
+            }
+            _eep_buf.run = 1;
+            _eep_buf.idx = 0;
+            continue;
+        }
+        d = blk->src[_eep_buf.idx];
+        eep_addr(blk->addr+_eep_buf.idx);
+        _eep_buf.idx++;
+        eep_read();
+        if (eep_data_get() != d) {
+            eep_data(d);
+            eep_write();
+            _eep_buf.written++;
+            return;  /* next byte on ready interrupt */
+        }
+    }
+}
+
+/* write all queued blocks now with interrupts off (brownout hook) */
+static inline void eep_buf_flush(void) {
+    uint8_t s = in(SREG);
+
+    cli();
+    while (_eep_buf.busy) {
+        eep_wait();
+        eep_buf_isr();
+    }
+    out(SREG, s);
+}
+
+
+#ifdef _EEP_BUF_H_TEST_
+
+/* write 64 byte record again and again, main loop counts on PORTB during write */
+/* PORTC toggles on done callback, PORTD shows written bytes (record changes every 4 writes, else 0) */
+
+EEPMEM uint8_t rec_eep[64];
+uint8_t rec[64];
+
+void on_done(const void *src) {
+    (void)src;
+    PORTC ^= 1;
+}
+
+int main(void) {
+    uint8_t i, n = 0, count = 0;
+    uint16_t w = 0;
+
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    eep_buf_en(on_done);
+    sei();
+
+    for (;;) {
+        for (i = 0; i < sizeof(rec); i++)
+            rec[i] = i+(n >> 2);  /* same record for 4 writes */
+        n++;
+        w = eep_buf_written();
+        eep_write_block((uint16_t)rec_eep, rec, sizeof(rec));
+        while (eep_buf_busy())
+            PORTB = ++count;  /* CPU is free during write */
+        PORTD = eep_buf_written()-w;
+    }
+
+    return 0;
+}
+
+ISR_EEP_RDY() {
+    eep_buf_isr();
+}
+
+#endif /* _EEP_BUF_H_TEST_ */
+
+
+#endif /* _EEP_BUF_H_ */
@@ -0,0 +1,238 @@
+/*
+ * Eeprom read cache with lazy write back
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call eep_cache_load() at boot, it reads EEP_CACHE_SIZE bytes at
+ *   EEP_CACHE_ADDR to RAM (EEPMEM variables start at 0, so defaults cache
+ *   first 64 bytes of eeprom section). Then reads of this region are RAM
+ *   reads (no eep_wait), writes change RAM and set a dirty bit per byte
+ *   (only if value changes). Addresses out of region use eeprom directly.
+ *
+ *   Write back: eep_cache_idle() (idle hook, call from main loop) writes at
+ *   most one dirty byte when eeprom is ready and never waits.
+ *   eep_cache_flush() writes all dirty bytes now (blocking). Dirty bytes
+ *   which are same as eeprom are not written.
+ *
+ *   Typed access of EEPMEM variables:
+ *
+ *     EEPMEM uint16_t speed_eep;
+ *     x = eep_cache_var(speed_eep);              (C)
+ *     eep_cache_var_set(speed_eep, x+1);
+ *
+ *     EepVar<uint16_t> speed(speed_eep);         (C++)
+ *     x = speed;
+ *     speed = x+1;
+ *
+ *   Cache is for main loop only, do not use with eep_buf.h on same time.
+ */
+
+
+#ifndef _EEP_CACHE_H_
+#define _EEP_CACHE_H_ 1
+
+
+#include "util.h"
+#include "eep.h"
+
+
+/* eeprom cache options */
+#ifndef EEP_CACHE_ADDR
+#define EEP_CACHE_ADDR  0   /* region start address */
+#endif /* EEP_CACHE_ADDR */
+#ifndef EEP_CACHE_SIZE
+#define EEP_CACHE_SIZE  64  /* region size (1 ~ 255) */
+#endif /* EEP_CACHE_SIZE */
+
+#if EEP_CACHE_SIZE < 1 || EEP_CACHE_SIZE > 255
+#error "EEP_CACHE_SIZE must be 1 ~ 255"
+#endif
+
+
+/* eeprom cache state */
+static struct {
+    uint8_t data[EEP_CACHE_SIZE];            /* cached bytes */
+    uint8_t dirty[(EEP_CACHE_SIZE+7)/8];     /* dirty bits */
+    uint8_t count;                           /* dirty bytes */
+    uint8_t scan;                            /* next byte to check in idle hook */
+} _eep_cache __attribute__((unused));
+
+
+/* eeprom cache macros */
+#define eep_cache_dirty()        (_eep_cache.count)  /* dirty bytes */
+#define eep_cache_var(var)       ({__typeof__(var) _v; eep_cache_read((uint16_t)(uintptr_t)&(var), &_v, sizeof(_v)); _v;})  /* read EEPMEM variable */
+#define eep_cache_var_set(var, vlu)  {__typeof__(var) _v = (vlu); eep_cache_write((uint16_t)(uintptr_t)&(var), &_v, sizeof(_v));}  /* write EEPMEM variable */
+#define _eep_cache_in(adr)       ((uint16_t)((adr)-EEP_CACHE_ADDR) < EEP_CACHE_SIZE)  /* address is in region */
+
+
+/* read region to RAM and clear dirty bits */
+static inline void eep_cache_load(void) {
+    uint8_t i;
+
+    eep_wait();
+    for (i = 0; i < EEP_CACHE_SIZE; i++) {
+        eep_addr(EEP_CACHE_ADDR+i);
+        eep_read();
+        _eep_cache.data[i] = eep_data_get();
+    }
+    for (i = 0; i < sizeof(_eep_cache.dirty); i++)
+        _eep_cache.dirty[i] = 0;
+    _eep_cache.count = 0;
+    _eep_cache.scan = 0;
+}
+
+/* read byte */
+static inline uint8_t eep_cache_get(uint16_t adr) {
+    if (!_eep_cache_in(adr))
+        return eep_read_byte(adr);
+    return _eep_cache.data[adr-EEP_CACHE_ADDR];
+}
+
+/* write byte (lazy in region) */
+static inline void eep_cache_set(uint16_t adr, uint8_t vlu) {
+    uint8_t i, m;
+
+    if (!_eep_cache_in(adr)) {
+        eep_write_byte(adr, vlu);
+        return;
+    }
+    i = adr-EEP_CACHE_ADDR;
+    if (_eep_cache.data[i] == vlu)
+        return;
+    _eep_cache.data[i] = vlu;
+    m = b1(i & 7);
+    if (!(_eep_cache.dirty[i >> 3] & m)) {
+        _eep_cache.dirty[i >> 3] |= m;
+        _eep_cache.count++;
+    }
+}
+
+/* read len bytes */
+static inline void eep_cache_read(uint16_t adr, void *dst, uint8_t len) {
+    uint8_t *d = (uint8_t *)dst;
+
+    while (len--)
+        *d++ = eep_cache_get(adr++);
+}
+
+/* write len bytes (lazy in region) */
+static inline void eep_cache_write(uint16_t adr, const void *src, uint8_t len) {
+    const uint8_t *s = (const uint8_t *)src;
+
+    while (len--)
+        eep_cache_set(adr++, *s++);
+}
+
+/* idle hook: write one dirty byte if eeprom is ready, return dirty bytes remain */
+static inline uint8_t eep_cache_idle(void) {
+    uint8_t i, m;
+
+    if (!_eep_cache.count || bis(EECR, EEWE))
+        return _eep_cache.count;
+    for (i = _eep_cache.scan; ; i = (i+1 < EEP_CACHE_SIZE)? i+1: 0) {
+        m = b1(i & 7);
+        if (_eep_cache.dirty[i >> 3] & m)
+            break;
+    }
+    _eep_cache.dirty[i >> 3] &= ~m;
+    _eep_cache.count--;
+    _eep_cache.scan = (i+1 < EEP_CACHE_SIZE)? i+1: 0;
+
+    eep_addr(EEP_CACHE_ADDR+i);
+    eep_read();
+    if (eep_data_get() != _eep_cache.data[i]) {
+        eep_data(_eep_cache.data[i]);
+        eep_write();
+    }
+    return _eep_cache.count;
+}
+
+/* write all dirty bytes (blocking) */
+static inline void eep_cache_flush(void) {
+    while (_eep_cache.count) {
+        eep_wait();
+        eep_cache_idle();
+    }
+}
+
+
+#ifdef __cplusplus
+
+/* cached EEPMEM variable (C++) */
+template <typename T>
+class EepVar {
+    const uint16_t adr;
+
+public:
+    EepVar(const T &var): adr((uint16_t)(uintptr_t)&var) {}
+
+    operator T() const {
+        T v;
+
+        eep_cache_read(adr, &v, sizeof(T));
+        return v;
+    }
+
+    EepVar &operator=(const T &v) {
+        eep_cache_write(adr, &v, sizeof(T));
+        return *this;
+    }
+};
+
+#endif /* __cplusplus */
+
+
+#ifdef _EEP_CACHE_H_TEST_
+
+/* boot counter in cached EEPMEM variable, main loop reads it without eep_wait */
+/* PORTB shows boots, PORTC shows dirty bytes (written back by idle hook) */
+
+EEPMEM uint16_t boots_eep = 0;
+
+#ifdef __cplusplus
+
+int main(void) {
+    EepVar<uint16_t> boots(boots_eep);
+
+    DDRB = ~0;
+    DDRC = ~0;
+
+    eep_cache_load();
+    boots = boots+1;
+
+    for (;;) {
+        PORTB = (uint16_t)boots;
+        PORTC = eep_cache_idle();
+    }
+
+    return 0;
+}
+
+#else /* !__cplusplus */
+
+int main(void) {
+    DDRB = ~0;
+    DDRC = ~0;
+
+    eep_cache_load();
+    eep_cache_var_set(boots_eep, eep_cache_var(boots_eep)+1);
+
+    for (;;) {
+        PORTB = eep_cache_var(boots_eep);
+        PORTC = eep_cache_idle();
+    }
+
+    return 0;
+}
+
+#endif /* __cplusplus */
+
+#endif /* _EEP_CACHE_H_TEST_ */
+
+
+#endif /* _EEP_CACHE_H_ */
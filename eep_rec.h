@@ -0,0 +1,239 @@
+/*
+ * Wear leveled eeprom record store
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Setup eeprom write queue (eep_buf.h: eep_buf_en() and ISR_EEP_RDY), call
+ *   eep_rec_init() at boot, then eep_rec_write(key, data) and
+ *   eep_rec_read(key, data) with EEP_REC_DATA bytes data.
+ *
+ *   Region of EEP_REC_SLOTS slots at EEP_REC_ADDR is a circular log, each
+ *   slot is one record: key (1), sequence number (4), data (EEP_REC_DATA),
+ *   CRC16 (2). Record bytes are written in this order, so CRC is last: a
+ *   record torn by power loss has bad CRC and is ignored, last good record
+ *   of key is used. New record goes to next slot which is not the latest
+ *   record of any key, so old value is kept until new one is complete.
+ *
+ *   eep_rec_init() scans all slots once and keeps the latest slot of each
+ *   key in RAM, so eep_rec_read() is O(1) (reads data of one slot).
+ *
+ *   Report (EEP_REC_DATA 9, 64 slots of 16 bytes = 1KB, 8 keys):
+ *     - wear amplification: each write programs one 16 byte slot for 9 data
+ *       bytes (1.8 bytes per data byte, less as equal bytes are skipped by
+ *       eep_buf), but writes rotate over at least 56 slots, so each eeprom
+ *       cell gets 1/56 of writes, 56/1.8 = 31 times longer life than write
+ *       in place.
+ *     - boot scan: 1024 eeprom reads and CRC16 updates, about 40 cycles per
+ *       byte, 41000 cycles (2.6ms at 16MHz, 5.1ms at 8MHz).
+ */
+
+
+#ifndef _EEP_REC_H_
+#define _EEP_REC_H_ 1
+
+
+#include <util/crc16.h>
+
+#include "util.h"
+#include "eep.h"
+#include "eep_buf.h"
+
+
+/* eeprom record store options */
+#ifndef EEP_REC_ADDR
+#define EEP_REC_ADDR   0   /* region start address */
+#endif /* EEP_REC_ADDR */
+#ifndef EEP_REC_SLOTS
+#define EEP_REC_SLOTS  64  /* region slots (2 ~ 254) */
+#endif /* EEP_REC_SLOTS */
+#ifndef EEP_REC_DATA
+#define EEP_REC_DATA   9   /* data bytes of record */
+#endif /* EEP_REC_DATA */
+#ifndef EEP_REC_KEYS
+#define EEP_REC_KEYS   8   /* keys (0 ~ EEP_REC_KEYS-1) */
+#endif /* EEP_REC_KEYS */
+
+#if EEP_REC_SLOTS > 254 || EEP_REC_SLOTS <= EEP_REC_KEYS
+#error "EEP_REC_SLOTS must be more than EEP_REC_KEYS and <= 254"
+#endif
+
+#define EEP_REC_SLOT  (7+EEP_REC_DATA)                          /* slot bytes */
+#define EEP_REC_END   (EEP_REC_ADDR+EEP_REC_SLOTS*EEP_REC_SLOT)  /* region end address */
+#define _EEP_REC_NONE 0xFF                                      /* no slot */
+
+#if EEP_REC_END > E2END+1
+#error "eeprom record region is out of eeprom"
+#endif
+
+
+/* eeprom record (slot layout) */
+typedef struct {
+    uint8_t key;                 /* key (0xFF: empty) */
+    uint32_t seq;                /* sequence number */
+    uint8_t data[EEP_REC_DATA];  /* data */
+    uint16_t crc;                /* CRC16 of key, seq and data */
+} _eep_rec_t;
+
+
+/* eeprom record store state */
+static struct {
+    uint8_t slot[EEP_REC_KEYS];  /* latest slot of key */
+    uint8_t head;                /* next slot to write */
+    uint32_t seq;                /* last sequence number */
+    _eep_rec_t buf;              /* record in write (until eep_buf is done) */
+} _eep_rec __attribute__((unused));
+
+
+/* eeprom record macros */
+#define eep_rec_has(key)      (_eep_rec.slot[key] != _EEP_REC_NONE)            /* key has a record */
+#define _eep_rec_addr(slt)    (EEP_REC_ADDR+(uint16_t)(slt)*EEP_REC_SLOT)     /* slot address */
+#define _eep_rec_next(slt)    (((slt)+1 < EEP_REC_SLOTS)? (slt)+1: 0)          /* next slot */
+
+
+/* CRC16 of record (without crc) */
+static inline uint16_t _eep_rec_crc(const _eep_rec_t *rec) {
+    const uint8_t *p = (const uint8_t *)rec;
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    for (i = 0; i < EEP_REC_SLOT-2; i++)
+        crc = _crc_ccitt_update(crc, p[i]);
+    return crc;
+}
+
+/* slot is latest record of a key */
+static inline uint8_t _eep_rec_live(uint8_t slt) {
+    uint8_t k;
+
+    for (k = 0; k < EEP_REC_KEYS; k++) {
+        if (_eep_rec.slot[k] == slt)
+            return 1;
+    }
+    return 0;
+}
+
+/* rebuild index from eeprom (boot), return number of keys with record */
+static inline uint8_t eep_rec_init(void) {
+    uint32_t seq[EEP_REC_KEYS];
+    _eep_rec_t rec;
+    uint8_t *p = (uint8_t *)&rec;
+    uint8_t s, i, last = _EEP_REC_NONE, n = 0;
+
+    for (i = 0; i < EEP_REC_KEYS; i++)
+        _eep_rec.slot[i] = _EEP_REC_NONE;
+    _eep_rec.seq = 0;
+    _eep_rec.buf.key = _EEP_REC_NONE;
+
+    for (s = 0; s < EEP_REC_SLOTS; s++) {
+        for (i = 0; i < EEP_REC_SLOT; i++)
+            p[i] = eep_buf_read_byte(_eep_rec_addr(s)+i);
+        if (rec.key >= EEP_REC_KEYS || rec.crc != _eep_rec_crc(&rec))
+            continue;  /* empty or torn */
+        if (_eep_rec.slot[rec.key] == _EEP_REC_NONE || rec.seq > seq[rec.key]) {
+            _eep_rec.slot[rec.key] = s;
+            seq[rec.key] = rec.seq;
+        }
+        if (last == _EEP_REC_NONE || rec.seq > _eep_rec.seq) {
+            _eep_rec.seq = rec.seq;
+            last = s;
+        }
+    }
+
+    _eep_rec.head = (last == _EEP_REC_NONE)? 0: _eep_rec_next(last);
+    for (i = 0; i < EEP_REC_KEYS; i++) {
+        if (_eep_rec.slot[i] != _EEP_REC_NONE)
+            n++;
+    }
+    return n;
+}
+
+/* write record of key (EEP_REC_DATA bytes), return 0 on bad key or full eeprom queue */
+static inline uint8_t eep_rec_write(uint8_t key, const void *data) {
+    const uint8_t *d = (const uint8_t *)data;
+    uint8_t s, i;
+
+    if (key >= EEP_REC_KEYS)
+        return 0;
+    eep_buf_wait();  /* last record is written, buf is free */
+
+    s = _eep_rec.head;
+    while (_eep_rec_live(s))
+        s = _eep_rec_next(s);  /* keep latest records (slots > keys) */
+
+    _eep_rec.buf.key = key;
+    _eep_rec.buf.seq = ++_eep_rec.seq;
+    for (i = 0; i < EEP_REC_DATA; i++)
+        _eep_rec.buf.data[i] = d[i];
+    _eep_rec.buf.crc = _eep_rec_crc(&_eep_rec.buf);
+    if (!eep_write_block(_eep_rec_addr(s), &_eep_rec.buf, EEP_REC_SLOT))
+        return 0;
+
+    _eep_rec.slot[key] = s;
+    _eep_rec.head = _eep_rec_next(s);
+    return 1;
+}
+
+/* read latest record of key (EEP_REC_DATA bytes), return 0 if key has no record */
+static inline uint8_t eep_rec_read(uint8_t key, void *data) {
+    uint8_t *d = (uint8_t *)data;
+    uint16_t adr;
+    uint8_t i;
+
+    if (key >= EEP_REC_KEYS || _eep_rec.slot[key] == _EEP_REC_NONE)
+        return 0;
+    if (eep_buf_busy() && _eep_rec.buf.key == key) {
+        for (i = 0; i < EEP_REC_DATA; i++)
+            d[i] = _eep_rec.buf.data[i];  /* in write, RAM copy */
+        return 1;
+    }
+    adr = _eep_rec_addr(_eep_rec.slot[key])+5;
+    for (i = 0; i < EEP_REC_DATA; i++)
+        d[i] = eep_buf_read_byte(adr+i);
+    return 1;
+}
+
+
+#ifdef _EEP_REC_H_TEST_
+
+/* boot counter in key 0: PORTB shows boot scan time (timer1 at F_CPU/1024, about 40), PORTC shows boots */
+/* PORTD shows keys with record */
+
+int main(void) {
+    uint8_t data[EEP_REC_DATA] = {0};
+    uint16_t t;
+
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    eep_buf_en(0);
+    sei();
+
+    TCCR1B = b1(CS12)|b1(CS10);
+    t = in(TCNT1);
+    PORTD = eep_rec_init();
+    PORTB = in(TCNT1)-t;
+
+    eep_rec_read(0, data);
+    data[0]++;
+    eep_rec_write(0, data);
+    PORTC = data[0];
+
+    for (;;);
+
+    return 0;
+}
+
+ISR_EEP_RDY() {
+    eep_buf_isr();
+}
+
+#endif /* _EEP_REC_H_TEST_ */
+
+
+#endif /* _EEP_REC_H_ */
@@ -0,0 +1,269 @@
+/*
+ * Append only flash log
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Set FLASH_LOG_START (page aligned, out of application code) and
+ *   FLASH_LOG_PAGES, link .bootloader section to boot section (SPM works
+ *   only from there), call flash_log_init() at boot. Default region ends
+ *   below last application page (length and CRC of boot.h); include boot.h
+ *   first to follow its BOOT_SIZE.
+ *
+ *   flash_log_append(data, len) copies a record to RAM page buffer, a full
+ *   page is written by one SPM routine in BOOTMEM. flash_log_sync() writes
+ *   a partial page (rest of page is not used). Pages are a ring, each page
+ *   starts with a 16bit sequence number, so flash_log_init() finds newest
+ *   page and oldest pages are overwritten.
+ *
+ *   Application code is in RWW section, so CPU stalls (interrupts off) while
+ *   a page is erased or written, about 4.5ms each (ATmega16/32). Erase
+ *   ahead: flash_log_idle() erases next page in a time chosen by
+ *   application, then a full page stalls only for the write. Without it,
+ *   page write stalls for erase and write.
+ *
+ *   flash_log_first() and flash_log_next() read records from oldest to
+ *   newest by pgm_read (records in RAM buffer are not read until sync).
+ *
+ *   Benchmark (ATmega32, 128 byte pages, 16 byte records, 7 records per
+ *   page, datasheet write and erase times):
+ *     - append without page write: about 150 cycles
+ *     - worst stall: 9ms (erase and write), 4.5ms with flash_log_idle
+ *     - throughput: 112 bytes per 9ms = 12KB/s, 25KB/s with erase ahead
+ */
+
+
+#ifndef _FLASH_LOG_H_
+#define _FLASH_LOG_H_ 1
+
+
+#include <avr/pgmspace.h>
+
+#include "util.h"
+#include "spm.h"
+
+
+/* flash log options */
+#ifndef FLASH_LOG_PAGES
+#define FLASH_LOG_PAGES  32  /* pages in ring (2 ~ 255) */
+#endif /* FLASH_LOG_PAGES */
+#ifndef FLASH_LOG_START
+#ifdef BOOT_APP_END
+#define FLASH_LOG_START  (BOOT_APP_END-FLASH_LOG_PAGES*SPM_PAGESIZE)  /* below application info page of boot.h */
+#else /* !BOOT_APP_END */
+#define FLASH_LOG_START  (FLASHEND+1-2048-SPM_PAGESIZE-FLASH_LOG_PAGES*SPM_PAGESIZE)  /* below 2KB boot section and its info page */
+#endif /* BOOT_APP_END */
+#endif /* FLASH_LOG_START */
+
+#if FLASH_LOG_PAGES < 2 || FLASH_LOG_PAGES > 255
+#error "FLASH_LOG_PAGES must be 2 ~ 255"
+#endif
+#if FLASH_LOG_START % SPM_PAGESIZE
+#error "FLASH_LOG_START must be page aligned"
+#endif
+#if defined(BOOT_APP_END) && FLASH_LOG_START+FLASH_LOG_PAGES*SPM_PAGESIZE > BOOT_APP_END
+#error "flash log region overlaps application info page of boot.h"
+#endif
+
+#define FLASH_LOG_END     (FLASH_LOG_START+FLASH_LOG_PAGES*SPM_PAGESIZE)  /* region end address */
+#define FLASH_LOG_RECORD  (SPM_PAGESIZE-3)                               /* max record length */
+
+
+/* flash log read cursor */
+typedef struct {
+    uint8_t page;  /* page index */
+    uint8_t left;  /* pages to read */
+    uint16_t off;  /* offset in page */
+} flash_log_cur_t;
+
+
+/* flash log state */
+static struct {
+    uint8_t buf[SPM_PAGESIZE];  /* page in RAM: seq, records ([len][data]) */
+    uint16_t len;               /* used bytes of buf */
+    uint16_t seq;               /* sequence number of buf */
+    uint8_t page;               /* page index of buf */
+    uint8_t erased;             /* page of buf is erased ahead */
+} _flash_log __attribute__((unused));
+
+
+/* flash log macros */
+#define _flash_log_addr(pg)  (FLASH_LOG_START+(uint16_t)(pg)*SPM_PAGESIZE)  /* page address */
+#define _flash_log_next(pg)  (((pg)+1 < FLASH_LOG_PAGES)? (pg)+1: 0)      /* next page */
+#define _flash_log_seq(pg)   pgm_read_word(_flash_log_addr(pg))             /* page sequence number */
+
+
+/* SPM routine: erase page (buf 0) or write buf to page, then enable RWW read (in boot section) */
+static void BOOTMEM __attribute__((noinline, unused)) _flash_log_spm(uint16_t adr, const uint8_t *buf) {
+    uint8_t i, s = in(SREG);
+
+    cli();
+    wait_clear_bit(EECR, EEWE);  /* no SPM while eeprom write */
+    if (buf) {
+        for (i = 0; i < SPM_PAGESIZE/2; i++)
+            spm_page_fill(adr+2*i, buf[2*i] | (buf[2*i+1] << 8));
+        spm_page_write(adr);
+    } else {
+        spm_page_erase(adr);
+    }
+    spm_wait();
+    spm_rww_read_en();
+    spm_wait();
+    out(SREG, s);
+}
+
+/* find newest page and start after it */
+static inline void flash_log_init(void) {
+    uint16_t seq, last = 0;
+    uint8_t p, newest = 0xFF;
+
+    for (p = 0; p < FLASH_LOG_PAGES; p++) {
+        seq = _flash_log_seq(p);
+        if (seq == 0xFFFF)
+            continue;  /* erased */
+        if (newest == 0xFF || (int16_t)(seq-last) > 0) {
+            newest = p;
+            last = seq;
+        }
+    }
+    _flash_log.page = (newest == 0xFF)? 0: _flash_log_next(newest);
+    _flash_log.seq = (newest == 0xFF || last == 0xFFFE)? 0: last+1;
+    _flash_log.len = 2;
+    _flash_log.erased = 0;
+}
+
+/* erase next page now (idle hook, stalls about 4.5ms if not erased) */
+static inline void flash_log_idle(void) {
+    if (_flash_log.erased)
+        return;
+    _flash_log_spm(_flash_log_addr(_flash_log.page), 0);
+    _flash_log.erased = 1;
+}
+
+/* write partial page to flash (stalls), next record starts a new page */
+static inline void flash_log_sync(void) {
+    uint16_t i;
+
+    if (_flash_log.len <= 2)
+        return;
+    for (i = _flash_log.len; i < SPM_PAGESIZE; i++)
+        _flash_log.buf[i] = 0xFF;
+    _flash_log.buf[0] = _flash_log.seq;
+    _flash_log.buf[1] = _flash_log.seq >> 8;
+    flash_log_idle();
+    _flash_log_spm(_flash_log_addr(_flash_log.page), _flash_log.buf);
+
+    _flash_log.page = _flash_log_next(_flash_log.page);
+    _flash_log.seq = (_flash_log.seq == 0xFFFE)? 0: _flash_log.seq+1;  /* 0xFFFF is erased */
+    _flash_log.len = 2;
+    _flash_log.erased = 0;
+}
+
+/* append record (1 ~ FLASH_LOG_RECORD bytes), return 0 on bad length */
+static inline uint8_t flash_log_append(const void *data, uint8_t len) {
+    const uint8_t *d = (const uint8_t *)data;
+
+    if (!len || len > FLASH_LOG_RECORD)
+        return 0;
+    if (_flash_log.len+1+len > SPM_PAGESIZE)
+        flash_log_sync();
+    _flash_log.buf[_flash_log.len++] = len;
+    while (len--)
+        _flash_log.buf[_flash_log.len++] = *d++;
+    return 1;
+}
+
+/* start read at oldest page */
+static inline void flash_log_first(flash_log_cur_t *cur) {
+    cur->page = _flash_log_next(_flash_log.page);
+    cur->left = FLASH_LOG_PAGES-1;  /* all but page in RAM */
+    cur->off = 2;
+}
+
+/* read next record to buf (max bytes), return record length or -1 at end */
+static inline int16_t flash_log_next(flash_log_cur_t *cur, void *buf, uint8_t max) {
+    uint8_t *b = (uint8_t *)buf;
+    uint16_t adr;
+    uint8_t i, len;
+
+    while (cur->left) {
+        adr = _flash_log_addr(cur->page);
+        if (cur->off < SPM_PAGESIZE && _flash_log_seq(cur->page) != 0xFFFF) {
+            len = pgm_read_byte(adr+cur->off);
+            if (len != 0xFF) {
+                for (i = 0; i < len && i < max; i++)
+                    b[i] = pgm_read_byte(adr+cur->off+1+i);
+                cur->off += 1+len;
+                return len;
+            }
+        }
+        cur->page = _flash_log_next(cur->page);
+        cur->left--;
+        cur->off = 2;
+    }
+    return -1;
+}
+
+
+#ifdef _FLASH_LOG_H_TEST_
+
+/* append 16 byte records (timer1 at F_CPU/64, 4us at 16MHz) */
+/* PORTB: worst append time/16 without idle erase, PORTC: same with flash_log_idle between pages */
+/* PORTA: throughput of second loop in 100 bytes/s, PORTD: records read back */
+
+int main(void) {
+    uint8_t rec[16] = {0}, n;
+    uint16_t t, worst;
+    uint32_t total;
+    flash_log_cur_t cur;
+
+    DDRA = ~0;
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    flash_log_init();
+    TCCR1B = b1(CS11)|b1(CS10);
+
+    for (worst = 0, n = 0; n < 32; n++) {
+        rec[0] = n;
+        t = in(TCNT1);
+        flash_log_append(rec, sizeof(rec));
+        t = in(TCNT1)-t;
+        if (t > worst)
+            worst = t;
+    }
+    PORTB = worst >> 4;
+
+    for (total = 0, worst = 0, n = 0; n < 32; n++) {
+        rec[0] = n;
+        if (_flash_log.len == 2)
+            flash_log_idle();  /* application idle time */
+        t = in(TCNT1);
+        flash_log_append(rec, sizeof(rec));
+        t = in(TCNT1)-t;
+        total += t;
+        if (t > worst)
+            worst = t;
+    }
+    PORTC = worst >> 4;
+    PORTA = (32UL*sizeof(rec)*(F_CPU/64)/total)/100;
+
+    flash_log_sync();
+    flash_log_first(&cur);
+    for (n = 0; flash_log_next(&cur, rec, sizeof(rec)) >= 0; n++);
+    PORTD = n;
+
+    for (;;);
+
+    return 0;
+}
+
+#endif /* _FLASH_LOG_H_TEST_ */
+
+
+#endif /* _FLASH_LOG_H_ */
@@ -0,0 +1,256 @@
+/*
+ * Gated and reciprocal frequency counter
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Connect signal to T1 (gated count) and ICP1 (reciprocal), a 32.768kHz
+ *   crystal to TOSC1,2 (timer2 RTC makes gate), forward interrupts and call
+ *   freq_en(), then freq_poll() in main loop returns 1 with new freq_get():
+ *
+ *     ISR_TIMER1_CAPT() {capture_isr();}
+ *     ISR_TIMER1_OVF() {capture_ovf_isr();}
+ *     ISR_TIMER2_OVF() {freq_gate_isr();}
+ *
+ *   Gated mode: timer1 counts T1 edges (32bit by overflow of capture.h),
+ *   gate ISR (timer2 overflow, FREQ_GATE_DIV*7.8ms) reads count without dead
+ *   time, so frequency = counts*gate rate. Resolution is one count per gate
+ *   (1/(f*gate)), up to about F_CPU/2.5 (T1 sampling).
+ *
+ *   Reciprocal mode (capture.h): when a gate counts less than FREQ_LOW Hz,
+ *   timer1 runs at F_CPU and averages n periods (periods in one gate, 1 ~
+ *   255), resolution is one F_CPU cycle over n periods, so low frequencies
+ *   keep resolution of about 1/(F_CPU*gate) instead of 1/(f*gate).
+ *   Capture ISR takes one interrupt per edge, so each FREQ_CHECK gates a
+ *   gated count checks frequency again and picks mode (a jump above
+ *   F_CPU/100 in reciprocal mode is found in next check). Check gate stays
+ *   gated only above FREQ_HIGH (hysteresis, no mode flapping near
+ *   FREQ_LOW) and gives a result only then.
+ *
+ *   Timer2 is the gate, do not use it with PM_TICKLESS of pm.h. Counter
+ *   and capture.h state are static, so ISRs and freq_poll() must be in one
+ *   source file.
+ */
+
+
+#ifndef _FREQ_H_
+#define _FREQ_H_ 1
+
+
+#include "util.h"
+#include "timer1.h"
+#include "timer2.h"
+#include "capture.h"
+
+
+/* frequency counter options */
+#ifndef FREQ_GATE_DIV
+#define FREQ_GATE_DIV  32          /* timer2 prescaler: 8, 32, 64, 128, 256 or 1024 (gate 62.5ms ~ 8s) */
+#endif /* FREQ_GATE_DIV */
+#ifndef FREQ_LOW
+#define FREQ_LOW       (F_CPU/400)  /* reciprocal mode below (Hz) */
+#endif /* FREQ_LOW */
+#ifndef FREQ_HIGH
+#define FREQ_HIGH      (FREQ_LOW+FREQ_LOW/4)  /* gated mode again above (Hz) */
+#endif /* FREQ_HIGH */
+#ifndef FREQ_CHECK
+#define FREQ_CHECK     8            /* gates of reciprocal mode between gated checks */
+#endif /* FREQ_CHECK */
+
+#if FREQ_HIGH < FREQ_LOW
+#error "FREQ_HIGH must be at least FREQ_LOW"
+#endif
+
+#if FREQ_GATE_DIV == 8
+#define _FREQ_GATE_CK  TIMER2_CK_DIV8
+#elif FREQ_GATE_DIV == 32
+#define _FREQ_GATE_CK  TIMER2_CK_DIV32
+#elif FREQ_GATE_DIV == 64
+#define _FREQ_GATE_CK  TIMER2_CK_DIV64
+#elif FREQ_GATE_DIV == 128
+#define _FREQ_GATE_CK  TIMER2_CK_DIV128
+#elif FREQ_GATE_DIV == 256
+#define _FREQ_GATE_CK  TIMER2_CK_DIV256
+#elif FREQ_GATE_DIV == 1024
+#define _FREQ_GATE_CK  TIMER2_CK_DIV1024
+#else
+#error "FREQ_GATE_DIV must be 8, 32, 64, 128, 256 or 1024"
+#endif
+
+#define FREQ_GATE_HZ     (128.0/FREQ_GATE_DIV)                         /* gates per second (32768/256/FREQ_GATE_DIV) */
+#define _FREQ_LOW_COUNT  ((uint32_t)((double)FREQ_LOW/FREQ_GATE_HZ))  /* counts of FREQ_LOW in a gate */
+#define _FREQ_HIGH_COUNT ((uint32_t)((double)FREQ_HIGH/FREQ_GATE_HZ)) /* counts of FREQ_HIGH in a gate */
+
+
+/* frequency counter modes (freq_mode) */
+#define FREQ_GATED  0  /* count T1 in gate */
+#define FREQ_RECIP  1  /* reciprocal (input capture) */
+
+
+/* frequency counter state */
+static struct {
+    volatile uint8_t mode;    /* FREQ_GATED or FREQ_RECIP */
+    volatile uint8_t ready;   /* new gated count */
+    volatile uint32_t count;  /* counts of last gate */
+    uint32_t last;            /* T1 count at last gate */
+    uint8_t gates;            /* gates in reciprocal mode */
+    uint8_t check;            /* next gate checks mode (after reciprocal) */
+    float hz;                 /* last result */
+} _freq __attribute__((unused));
+
+
+/* frequency counter macros */
+#define freq_get()   (_freq.hz)    /* last frequency (Hz) */
+#define freq_mode()  (_freq.mode)  /* running mode */
+
+
+/* timer1 counts T1 (gated mode) */
+static inline void _freq_gated(void) {
+    cmi(TIMSK, TIMER1_INT_CAPT | TIMER1_INT_OVF);
+    timer1_set(TIMER1_MODE_NORMAL | TIMER1_CK_T1_RISE);
+    timer1_value(0);
+    _capture.ovf = 0;
+    _freq.last = 0;
+    out(TIFR, b1(TOV1));
+    timer1_signal(TIMER1_INT_OVF);
+    _freq.check = 1;
+    _freq.mode = FREQ_GATED;
+}
+
+/* start gate and counter */
+static inline void freq_en(void) {
+    _freq.ready = 0;
+    _freq.hz = 0;
+    capture_src_icp();
+    _freq_gated();
+
+    cbi(TIMSK, TOIE2);
+    timer2_rtc_mode_en();
+    timer2_set(TIMER2_MODE_NORMAL | _FREQ_GATE_CK);
+    timer2_value(0);
+    timer2_update_wait();
+    out(TIFR, b1(TOV2));
+    timer2_signal(TIMER2_INT_OVF);
+}
+
+/* gate handler (timer2 overflow) */
+static inline void freq_gate_isr(void) {
+    uint16_t lo, hi;
+    uint32_t c;
+
+    if (_freq.mode == FREQ_RECIP) {
+        if (++_freq.gates >= FREQ_CHECK)
+            _freq_gated();  /* check by gated count */
+        return;
+    }
+
+    lo = in(TCNT1);
+    hi = _capture.ovf;
+    if (bis(TIFR, TOV1) && lo < 0x8000)
+        hi++;  /* overflow before read is pending */
+    c = ((uint32_t)hi << 16) | lo;
+    c -= _freq.last;
+    _freq.last += c;
+
+    if (c < (_freq.check? _FREQ_HIGH_COUNT: _FREQ_LOW_COUNT)) {
+        _freq.gates = 0;
+        _freq.mode = FREQ_RECIP;
+        capture_en((c > 255)? 255: (c? c: 1), TIMER1_CAPTURE_RISING_EDGE);
+        return;
+    }
+    _freq.check = 0;
+    _freq.count = c;
+    _freq.ready = 1;
+}
+
+/* update result, return 1 if there is new result */
+static inline uint8_t freq_poll(void) {
+    uint32_t c;
+    uint8_t s;
+
+    if (_freq.ready) {
+        s = in(SREG);
+        cli();
+        c = _freq.count;
+        _freq.ready = 0;
+        out(SREG, s);
+        _freq.hz = c*FREQ_GATE_HZ;
+        return 1;
+    }
+    if (_freq.mode == FREQ_RECIP && capture_ready()) {
+        _freq.hz = capture_freq();
+        return 1;
+    }
+    return 0;
+}
+
+
+#ifdef _FREQ_H_TEST_
+
+/* test signal: timer0 CTC toggles OC0 (PB3), connect it to T1 (PB1) and ICP1 (PD6) */
+/* steps from F_CPU/4 to about 30Hz, PORTA: step (bit7: reciprocal mode), PORTC: error in ppm (max 255) */
+
+#include "timer0.h"
+
+static const struct {
+    uint8_t ck;
+    uint16_t div;
+    uint8_t ocr;
+} steps[] = {
+    {TIMER0_CK_DIV1, 1, 1}, {TIMER0_CK_DIV1, 1, 9}, {TIMER0_CK_DIV1, 1, 99},
+    {TIMER0_CK_DIV8, 8, 99}, {TIMER0_CK_DIV64, 64, 99}, {TIMER0_CK_DIV256, 256, 99},
+    {TIMER0_CK_DIV1024, 1024, 255},
+};
+
+ISR_TIMER1_CAPT() {
+    capture_isr();
+}
+
+ISR_TIMER1_OVF() {
+    capture_ovf_isr();
+}
+
+ISR_TIMER2_OVF() {
+    freq_gate_isr();
+}
+
+int main(void) {
+    float f, e;
+    uint8_t i, n;
+
+    DDRA = ~0;
+    DDRB = b1(3);
+    DDRC = ~0;
+
+    freq_en();
+    sei();
+
+    for (;;) {
+        for (i = 0; i < sizeof(steps)/sizeof(steps[0]); i++) {
+            timer0_set(TIMER0_MODE_CTC | TIMER0_OC0_TOGGLE | steps[i].ck);
+            timer0_compare(steps[i].ocr);
+            f = (float)F_CPU/(2.0*steps[i].div*(steps[i].ocr+1));
+            for (n = 0; n < 2*FREQ_CHECK; ) {
+                if (freq_poll()) {
+                    n++;
+                    e = (freq_get()-f)/f*1e6;
+                    if (e < 0)
+                        e = -e;
+                    PORTA = i | (freq_mode() << 7);
+                    PORTC = (e > 255)? 255: e;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+#endif /* _FREQ_H_TEST_ */
+
+
+#endif /* _FREQ_H_ */
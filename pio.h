@@ -1,8 +1,8 @@
 /*
  * Parallel input/ouput ports
- * Copyright 2013-2022 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2022-03-04 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -53,8 +53,131 @@
 #define PIN(pin, bit)      ((PIN ## pin) & b1(bit))   /* get bit in input pins register */
 
 
+#ifdef __cplusplus
+
+/*
+ * Compile time pins (C++)
+ *
+ *   Pin<PortB, 3> is an empty type, so pins can be passed as values and
+ *   template arguments. Every access is a constant bit of a constant port:
+ *     set/clear/output/input -> sbi/cbi
+ *     read                   -> sbis/sbic (in condition)
+ *     write(x), mode(x)      -> sbrc/sbrs + sbi/cbi (x not literal, no read-modify-write)
+ *     toggle                 -> sbis + cbi/sbi (ATmega8/16/32 have no PINx toggle)
+ *   Pins<Pin<PortB, 1>, Pin<PortB, 5>> updates some pins of one port in one
+ *   masked write.
+ */
+
+#define _PIO_PORT_TYPE(prt)  struct Port ## prt { \
+    static volatile uint8_t &port() {return PORT ## prt;} \
+    static volatile uint8_t &ddr() {return DDR ## prt;} \
+    static volatile uint8_t &pin() {return PIN ## prt;} \
+}
+
+#ifdef PORTA
+_PIO_PORT_TYPE(A);
+#endif /* PORTA */
+#ifdef PORTB
+_PIO_PORT_TYPE(B);
+#endif /* PORTB */
+#ifdef PORTC
+_PIO_PORT_TYPE(C);
+#endif /* PORTC */
+#ifdef PORTD
+_PIO_PORT_TYPE(D);
+#endif /* PORTD */
+
+template <typename P, uint8_t B>
+struct Pin {
+    static_assert(B < 8, "Pin bit must be 0 ~ 7");
+
+    typedef P port_t;
+    static constexpr uint8_t bit = B;
+    static constexpr uint8_t mask = b1(B);
+
+    static void set() {sbi(P::port(), B);}
+    static void clear() {cbi(P::port(), B);}
+    static void toggle() {if (bis(P::port(), B)) cbi(P::port(), B); else sbi(P::port(), B);}
+    static void write(bool x) {if (x) set(); else clear();}
+    static bool read() {return bis(P::pin(), B);}
+    static bool latch() {return bis(P::port(), B);}
+    static void output() {sbi(P::ddr(), B);}
+    static void input() {cbi(P::ddr(), B);}
+    static void mode(bool x) {if (x) output(); else input();}
+    static void pullup(bool x) {write(x);}
+};
+
+template <typename A, typename B> struct _PioSamePort {static constexpr bool value = false;};
+template <typename A> struct _PioSamePort<A, A> {static constexpr bool value = true;};
+
+template <typename... T>
+struct _PioPins;
+
+template <typename T>
+struct _PioPins<T> {
+    typedef typename T::port_t port_t;
+    static constexpr uint8_t mask = T::mask;
+};
+
+template <typename T, typename... R>
+struct _PioPins<T, R...> {
+    typedef typename T::port_t port_t;
+    static_assert(_PioSamePort<port_t, typename _PioPins<R...>::port_t>::value, "Pins must be on one port");
+    static constexpr uint8_t mask = T::mask | _PioPins<R...>::mask;
+};
+
+template <typename... T>
+struct Pins {
+    typedef typename _PioPins<T...>::port_t port_t;
+    static constexpr uint8_t mask = _PioPins<T...>::mask;
+
+    static void set() {smi(port_t::port(), mask);}
+    static void clear() {cmi(port_t::port(), mask);}
+    static void toggle() {imi(port_t::port(), mask);}
+    static void write(uint8_t x) {out(port_t::port(), (in(port_t::port()) & ~mask) | (x & mask));}  /* x in port bit positions */
+    static uint8_t read() {return mis(port_t::pin(), mask);}
+    static void output() {smi(port_t::ddr(), mask);}
+    static void input() {cmi(port_t::ddr(), mask);}
+};
+
+#endif /* __cplusplus */
+
+
 #ifdef _PIO_H_TEST_
 
+#ifdef __cplusplus
+
+/* check with avr-objdump -d: expected instructions are in comments */
+
+typedef Pin<PortB, 0> key;
+typedef Pin<PortB, 4> led;
+typedef Pins<Pin<PortB, 5>, Pin<PortB, 6>, Pin<PortB, 7>> bar;
+
+template <typename P>
+void blink(P pin) {
+    pin.toggle();  /* sbis PORTB,4 - rjmp - cbi PORTB,4 - rjmp - sbi PORTB,4 */
+}
+
+int main(void) {
+    uint8_t i = 0;
+
+    key::input();   /* cbi DDRB,0 */
+    key::pullup(PIO_PULLUP);  /* sbi PORTB,0 */
+    led::output();  /* sbi DDRB,4 */
+    bar::output();  /* in - ori 0xE0 - out DDRB */
+
+    for (;;) {
+        led::write(key::read());  /* sbis PINB,0 - cbi PORTB,4 / sbi PORTB,4 */
+        if (!key::read())         /* sbic PINB,0 */
+            blink(led());
+        bar::write(i++ << 5);     /* in - andi 0x1F - or - out PORTB */
+    }
+
+    return 0;
+}
+
+#else /* !__cplusplus */
+
 int main(void) {
     DDR(B, 0, PIO_INPUT);
     DDR(B, 1, PIO_INPUT);
@@ -84,6 +207,8 @@ int main(void) {
     return 0;
 }
 
+#endif /* __cplusplus */
+
 #endif /* _PIO_H_TEST_*/
 
 
@@ -0,0 +1,309 @@
+/*
+ * Tickless idle power manager
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call pm_en() after tick_en(). Drivers register what must run in sleep
+ *   by pm_need(req) when work starts and pm_free(req) when it ends (from
+ *   ISR too), e.g.:
+ *
+ *     usart TX in flight, SPI, timer0/1 PWM  -> PM_CLKIO  (pm_free in TXC ISR)
+ *     adc conversion                        -> PM_ADC    (pm_free in ADC ISR)
+ *     timer2 RTC of application             -> PM_RTC
+ *     wake in 6 cycles (crystal oscillator) -> PM_FAST
+ *
+ *   Idle loop checks its work with interrupts off, then calls pm_idle(ms)
+ *   with milliseconds to next software deadline (PM_FOREVER if none).
+ *   pm_idle() picks deepest mode for registered needs and sleeps (sei and
+ *   sleep are one atomic pair, so an interrupt after the check still wakes):
+ *
+ *     PM_CLKIO            -> SLEEP_IDLE
+ *     PM_ADC              -> SLEEP_ADC (conversion starts on sleep)
+ *     PM_RTC or deadline  -> SLEEP_PWSAVE (SLEEP_EXSTANDBY with PM_FAST)
+ *     PM_FAST             -> SLEEP_STANDBY
+ *     nothing             -> SLEEP_PWDOWN (only external wake)
+ *
+ *   PM_TICKLESS 1 (32.768kHz crystal on TOSC, tick on timer0): timer2 RTC
+ *   counts 1024Hz and its compare match wakes at deadline (at most
+ *   PM_MAX_MS, call again for longer), 1ms tick interrupt is off in sleep and
+ *   sleep time is added to tick_millis() after wake. Sleep starts with reset
+ *   of timer2 prescaler (RTC count starts with tick timer phase) and ends at
+ *   next RTC count after wake (pm_idle returns up to 1ms later, ISRs are not
+ *   delayed), so time is counted between two RTC edges and tick does not
+ *   drift (unless an ISR runs at that edge). Put PM_RTC_ISR() in one source
+ *   file. Without it, a deadline needs the 1ms tick and CPU sleeps in
+ *   SLEEP_IDLE.
+ *
+ *   Needs and tick counter are static (one copy per source file): drivers
+ *   which call pm_need/pm_free, pm_idle() and TICK_ISR() of tick.h must be in
+ *   one source file.
+ *
+ *   PM_STATS 1 counts microseconds in each mode (pm_stats(SLEEP_X), exact
+ *   with PM_TICKLESS, tick does not count in deep modes without it).
+ */
+
+
+#ifndef _PM_H_
+#define _PM_H_ 1
+
+
+#include "util.h"
+#include "sleep.h"
+#include "tick.h"
+#include "timer2.h"
+
+
+/* power manager options */
+#ifdef _PM_H_TEST_
+#define PM_TICKLESS  1
+#define PM_STATS     1
+#endif /* _PM_H_TEST_ */
+#ifndef PM_TICKLESS
+#define PM_TICKLESS  0  /* timer2 RTC wakes at deadline and tick stops in sleep */
+#endif /* PM_TICKLESS */
+#ifndef PM_STATS
+#define PM_STATS     0  /* count microseconds in each sleep mode */
+#endif /* PM_STATS */
+
+#if PM_TICKLESS && !defined(OCR0)
+#error "PM_TICKLESS needs tick on timer0 (timer2 is RTC)"
+#endif
+
+
+/* power manager needs (pm_need, pm_free) */
+#define PM_CLKIO  0  /* I/O clock: usart, spi, timer0/1, sync timer2 */
+#define PM_ADC    1  /* adc conversion */
+#define PM_RTC    2  /* async timer2 */
+#define PM_FAST   3  /* fast wake up (oscillator runs) */
+#define _PM_NEEDS 4
+
+#define PM_FOREVER  0xFFFF  /* no deadline (pm_idle) */
+#define PM_MAX_MS   234     /* longest tickless sleep (240 RTC counts, 15 left for wake up) */
+
+
+/* power manager state */
+static struct {
+    volatile uint8_t need[_PM_NEEDS];  /* registered drivers of need */
+#if PM_TICKLESS
+    uint16_t frac;                     /* sleep time remainder (1/(1024*TICK_TOP) ms) */
+#endif /* PM_TICKLESS */
+#if PM_STATS
+    uint32_t us[8];                    /* microseconds in mode (SM bits) */
+#endif /* PM_STATS */
+} _pm __attribute__((unused));
+
+
+/* power manager macros */
+#define pm_needed(req)  (_pm.need[req])           /* drivers registered need */
+#define pm_stats(mod)   (_pm.us[(mod) >> SM0])    /* microseconds in mode (PM_STATS) */
+
+/* RTC compare match ISR (only wakes, naked) */
+#define PM_RTC_ISR()  ISR(TIMER2_COMP_vect, ISR_NAKED) {__asm__ __volatile__ ("reti");}
+
+
+/* clear needs and start RTC (PM_TICKLESS) */
+static inline void pm_en(void) {
+    uint8_t i;
+
+    for (i = 0; i < _PM_NEEDS; i++)
+        _pm.need[i] = 0;
+#if PM_TICKLESS
+    _pm.frac = 0;
+    cbi(TIMSK, OCIE2);
+    timer2_rtc_mode_en();
+    timer2_set(TIMER2_MODE_NORMAL | TIMER2_CK_DIV32);  /* 32768/32 = 1024Hz */
+    timer2_value(0);
+    timer2_update_wait();
+#endif /* PM_TICKLESS */
+#if PM_STATS
+    for (i = 0; i < 8; i++)
+        _pm.us[i] = 0;
+#endif /* PM_STATS */
+}
+
+/* register need (ISR safe) */
+static inline void pm_need(uint8_t req) {
+    uint8_t s = in(SREG);
+
+    cli();
+    _pm.need[req]++;
+    out(SREG, s);
+}
+
+/* unregister need (ISR safe) */
+static inline void pm_free(uint8_t req) {
+    uint8_t s = in(SREG);
+
+    cli();
+    if (_pm.need[req])
+        _pm.need[req]--;
+    out(SREG, s);
+}
+
+/* deepest sleep mode for registered needs (timed: wake at deadline) */
+static inline uint8_t pm_mode(uint8_t timed) {
+    if (_pm.need[PM_CLKIO] || (timed && !PM_TICKLESS))
+        return SLEEP_IDLE;  /* without RTC, deadline needs tick */
+    if (_pm.need[PM_ADC])
+        return SLEEP_ADC;
+    if (_pm.need[PM_RTC] || timed) {
+#ifdef SLEEP_EXSTANDBY
+        if (_pm.need[PM_FAST])
+            return SLEEP_EXSTANDBY;
+#endif /* SLEEP_EXSTANDBY */
+        return SLEEP_PWSAVE;
+    }
+    if (_pm.need[PM_FAST])
+        return SLEEP_STANDBY;
+    return SLEEP_PWDOWN;
+}
+
+/* sleep until interrupt or ms milliseconds (call with interrupts off, returns with them on) */
+static inline void pm_idle(uint16_t ms) {
+    uint8_t mod;
+#if PM_TICKLESS
+    uint8_t t = 0, t0 = 0, n = 0;
+    uint32_t f;
+#endif /* PM_TICKLESS */
+#if PM_STATS
+    uint32_t us = tick_micros();
+#endif /* PM_STATS */
+
+    if (!ms) {
+        sei();
+        return;
+    }
+    mod = pm_mode(ms != PM_FOREVER);
+
+#if PM_TICKLESS
+    if (ms != PM_FOREVER) {
+        out(TCCR2, in(TCCR2));
+        wait_clear_bit(ASSR, TCR2UB);  /* TCNT2 is valid one TOSC cycle after wake */
+        cbi(TIMSK, OCIE0);  /* tick off */
+        sbi(SFIOR, PSR2);
+        wait_clear_bit(SFIOR, PSR2);  /* prescaler is reset, RTC count starts now */
+        t0 = in(_TICK_TCNT);
+        if (bis(TIFR, _TICK_OCF) && t0 < TICK_TOP/2)
+            _tick_ms++;  /* pending compare match */
+        out(TIFR, b1(_TICK_OCF));
+        t = in(TCNT2);
+        n = (ms > PM_MAX_MS)? 240: ((uint32_t)ms*1024)/1000;
+        if (!n)
+            n = 1;  /* whole count is left, OCR2 update takes 2 TOSC cycles */
+        timer2_compare(t+n);
+        wait_clear_bit(ASSR, OCR2UB);
+        out(TIFR, b1(OCF2));
+        sbi(TIMSK, OCIE2);
+    }
+#endif /* PM_TICKLESS */
+
+    sleep_set(mod);
+    sleep_en();
+#if PM_TICKLESS
+    if (ms != PM_FOREVER && (uint8_t)(in(TCNT2)-t) >= n)
+        sei();  /* compare is passed, do not sleep a whole wrap */
+    else
+#endif /* PM_TICKLESS */
+    __asm__ __volatile__ ("sei" "\n\t" "sleep" "\n\t");
+    sleep_di();
+
+#if PM_TICKLESS
+    if (ms != PM_FOREVER) {
+        out(TCCR2, in(TCCR2));
+        wait_clear_bit(ASSR, TCR2UB);
+        n = in(TCNT2);
+        while (in(TCNT2) == n);  /* next RTC edge (wake up time is unknown) */
+        cli();
+        cbi(TIMSK, OCIE2);
+        /* time in 1/(1024*TICK_TOP) ms: remainder, tick timer before sleep, RTC counts */
+        f = _pm.frac+(uint32_t)t0*1024+(uint32_t)(uint8_t)(in(TCNT2)-t)*1000*TICK_TOP;
+        _tick_ms += f/(1024UL*TICK_TOP);
+        f %= 1024UL*TICK_TOP;
+        out(_TICK_TCNT, f >> 10);  /* restore part of millisecond */
+        _pm.frac = f & 1023;
+        out(TIFR, b1(_TICK_OCF));
+        sbi(TIMSK, OCIE0);  /* tick on */
+        sei();
+    }
+#endif /* PM_TICKLESS */
+
+#if PM_STATS
+    _pm.us[mod >> SM0] += tick_micros()-us;
+#endif /* PM_STATS */
+}
+
+
+#ifdef _PM_H_TEST_
+
+/* sample workload for 10s: adc conversion every 20ms, 5ms of I/O clock every 100ms, */
+/* PORTA, PORTB, PORTC: time in idle, adc noise reduction and power save (ms/64), PORTD: adc result */
+
+#include "adc.h"
+
+TICK_ISR()
+PM_RTC_ISR()
+
+int main(void) {
+    uint32_t now, adc = 0, io = 0, clk = 0;
+    uint16_t ms, d;
+
+    DDRA = ~0;
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    tick_en();
+    pm_en();
+    adc_set(ADC_VREF_AVCC | ADC_CK_DIV128 | ADC_INT_COMPLETE);
+    adc_en();
+    sei();
+
+    while ((now = tick_millis()) < 10000) {
+        if (now-adc >= 20) {
+            adc += 20;
+            pm_need(PM_ADC);  /* conversion starts on sleep (or in idle by ADSC) */
+            sbi(ADCSRA, ADSC);
+        }
+        if (now-io >= 100) {
+            io += 100;
+            clk = now+5;
+            pm_need(PM_CLKIO);  /* e.g. usart frame in flight */
+        }
+        if (clk && now >= clk) {
+            clk = 0;
+            pm_free(PM_CLKIO);
+        }
+
+        ms = adc+20-now;
+        d = io+100-now;
+        if (d < ms)
+            ms = d;
+        if (clk && clk-now < ms)
+            ms = clk-now;
+        cli();
+        pm_idle(ms);
+    }
+
+    PORTA = pm_stats(SLEEP_IDLE)/64000;
+    PORTB = pm_stats(SLEEP_ADC)/64000;
+    PORTC = pm_stats(SLEEP_PWSAVE)/64000;
+
+    for (;;);
+
+    return 0;
+}
+
+ISR_ADC() {
+    PORTD = adc_data() >> 2;
+    pm_free(PM_ADC);
+}
+
+#endif /* _PM_H_TEST_ */
+
+
+#endif /* _PM_H_ */
@@ -0,0 +1,135 @@
+/*
+ * Stackless protothreads
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   A protothread is a function which returns PT_RUN while it waits and
+ *   PT_END when it is done; it keeps only a resume address (pt_t, 2 bytes)
+ *   between calls. Write a sequence linearly and call it from main loop (or
+ *   a scheduler task) until it returns PT_END:
+ *
+ *     uint8_t rd_reg(pt_t *pt) {
+ *         pt_begin(pt);
+ *         twi_start();
+ *         pt_wait_set_bit(pt, TWCR, TWINT);  (returns here, resumes later)
+ *         ...
+ *         pt_end(pt);
+ *     }
+ *
+ *   pt_wait_set_bit, pt_wait_clear_bit, pt_wait_set_mask and
+ *   pt_wait_clear_mask are the yielding forms of wait_* of util.h.
+ *   pt_spawn(pt, child, call) waits for a child protothread.
+ *
+ *   Resume uses labels as values of GCC (goto *lc), so switch can be used in
+ *   body. Local variables are lost at each wait, keep them in a struct with
+ *   pt_t (static, no heap). pt_begin must come before declarations with
+ *   initializers (resume jumps over them) and body must not have variable
+ *   length arrays (goto must not jump into their scope).
+ */
+
+
+#ifndef _PT_H_
+#define _PT_H_ 1
+
+
+#include "util.h"
+
+
+/* protothread status (return value) */
+#define PT_RUN  0  /* waits, call again */
+#define PT_END  1  /* done (next call starts again) */
+
+
+/* protothread state (resume address) */
+typedef struct {
+    void *lc;  /* label to resume or 0 */
+} pt_t;
+
+
+/* protothread macros */
+#define _PT_CAT2(a, b)              a ## b
+#define _PT_CAT(a, b)               _PT_CAT2(a, b)
+#define _pt_wait(pt, cond, n)       {_PT_CAT(_pt_lc_, n): if (!(cond)) {(pt)->lc = &&_PT_CAT(_pt_lc_, n); return PT_RUN;}}
+#define _pt_yield(pt, n)            {(pt)->lc = &&_PT_CAT(_pt_lc_, n); return PT_RUN; _PT_CAT(_pt_lc_, n):;}
+
+#define pt_init(pt)                 {(pt)->lc = 0;}                              /* start from begin */
+#define pt_begin(pt)                {if ((pt)->lc) goto *(pt)->lc;}              /* first statement of protothread */
+#define pt_end(pt)                  {(pt)->lc = 0; return PT_END;}               /* last statement of protothread */
+#define pt_exit(pt)                 pt_end(pt)                                   /* end now */
+#define pt_restart(pt)              {(pt)->lc = 0; return PT_RUN;}               /* start again at next call */
+#define pt_yield(pt)                _pt_yield(pt, __COUNTER__)                   /* return once */
+#define pt_wait_until(pt, cond)     _pt_wait(pt, cond, __COUNTER__)              /* return until condition is true */
+#define pt_wait_while(pt, cond)     pt_wait_until(pt, !(cond))                  /* return while condition is true */
+#define pt_wait_clear_bit(pt, reg, bit)   pt_wait_until(pt, bic(reg, bit))      /* return until bit in io is clear */
+#define pt_wait_set_bit(pt, reg, bit)     pt_wait_until(pt, bis(reg, bit))      /* return until bit in io is set */
+#define pt_wait_clear_mask(pt, reg, msk)  pt_wait_until(pt, mic(reg, msk))      /* return until mask in io is clear */
+#define pt_wait_set_mask(pt, reg, msk)    pt_wait_until(pt, mis(reg, msk))      /* return until mask in io is set */
+#define pt_spawn(pt, child, call)   {pt_init(child); pt_wait_until(pt, (call) == PT_END);}  /* run child protothread to end */
+
+
+#ifdef _PT_H_TEST_
+
+/* eeprom block writer yields on EEWE, blinker yields on timer1 compare flag */
+/* PORTB0 blinks while eeprom is written, PORTC counts main loop passes (not blocked by eeprom) */
+
+#include "eep.h"
+
+static struct {
+    pt_t pt;
+    uint8_t i;
+} wr;
+
+static pt_t blink;
+
+static uint8_t eep_block(void) {
+    pt_begin(&wr.pt);
+    for (wr.i = 0; wr.i < 64; wr.i++) {
+        pt_wait_clear_bit(&wr.pt, EECR, EEWE);
+        eep_addr(wr.i);
+        eep_data(wr.i);
+        eep_write();
+    }
+    pt_end(&wr.pt);
+}
+
+static uint8_t blinker(void) {
+    pt_begin(&blink);
+    for (;;) {
+        pt_wait_set_bit(&blink, TIFR, OCF1A);
+        out(TIFR, b1(OCF1A));
+        ibi(PORTB, 0);
+    }
+    pt_end(&blink);
+}
+
+int main(void) {
+    uint8_t done = 0;
+
+    DDRB = ~0;
+    DDRC = ~0;
+
+    TCCR1B = b1(WGM12)|b1(CS11)|b1(CS10);
+    OCR1A = F_CPU/64/100;
+    pt_init(&wr.pt);
+    pt_init(&blink);
+
+    for (;;) {
+        if (!done)
+            done = eep_block();
+        blinker();
+        if (!done)
+            PORTC++;
+    }
+
+    return 0;
+}
+
+#endif /* _PT_H_TEST_ */
+
+
+#endif /* _PT_H_ */
@@ -0,0 +1,186 @@
+/*
+ * Cooperative event scheduler
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Register tasks by sched_add(id, fn), id is priority (0 is highest).
+ *   ISRs set event bits of a task by sched_post_isr(id, ev), main code by
+ *   sched_post(id, ev). sched_run() never returns: it runs highest ready
+ *   task with its events (cleared before call) and sleeps in SCHED_SLEEP
+ *   when no task is ready:
+ *
+ *     void rx_task(uint8_t ev) {...}
+ *     ISR_USART_RXC() {... sched_post_isr(0, 1);}
+ *
+ *   Tasks run to completion (no preemption, no stack per task), task and
+ *   event tables are static (no heap). For own idle (e.g. pm_idle of pm.h)
+ *   call sched_step() in loop: it returns 0 with interrupts off if no task is
+ *   ready, then sleep must enable interrupts (sei and sleep pair). Tables
+ *   are static in header, so tasks must be added and posted from one source
+ *   file (each source file which includes it has its own scheduler).
+ *
+ *   Latency from event to handler is dispatch (about 40 cycles) plus
+ *   longest task which runs at that time, not sum of all handlers like a
+ *   superloop which polls each *_wait flag in turn.
+ */
+
+
+#ifndef _SCHED_H_
+#define _SCHED_H_ 1
+
+
+#include "util.h"
+#include "sleep.h"
+
+
+/* scheduler options */
+#ifndef SCHED_TASKS
+#define SCHED_TASKS  8           /* tasks (1 ~ 8) */
+#endif /* SCHED_TASKS */
+#ifndef SCHED_SLEEP
+#define SCHED_SLEEP  SLEEP_IDLE  /* sleep mode when no task is ready */
+#endif /* SCHED_SLEEP */
+
+#if SCHED_TASKS < 1 || SCHED_TASKS > 8
+#error "SCHED_TASKS must be 1 ~ 8"
+#endif
+
+
+/* task handler (events of task) */
+typedef void (*sched_fn_t)(uint8_t ev);
+
+
+/* scheduler state */
+static struct {
+    sched_fn_t fn[SCHED_TASKS];         /* task handlers */
+    volatile uint8_t ev[SCHED_TASKS];   /* pending events of task */
+    volatile uint8_t ready;             /* ready tasks (bit of id) */
+} _sched __attribute__((unused));
+
+
+/* scheduler macros */
+#define sched_add(id, f)          {_sched.fn[id] = (f);}                                /* register task */
+#define sched_ready()             (_sched.ready)                                       /* ready tasks */
+#define sched_post_isr(id, evt)   {_sched.ev[id] |= (evt); _sched.ready |= b1(id);}    /* set events of task (interrupts off) */
+
+
+/* set events of task (main code) */
+static inline void sched_post(uint8_t id, uint8_t ev) {
+    uint8_t s = in(SREG);
+
+    cli();
+    sched_post_isr(id, ev);
+    out(SREG, s);
+}
+
+/* run highest ready task, return 0 with interrupts off if none is ready */
+static inline uint8_t sched_step(void) {
+    uint8_t id, m, ev;
+
+    cli();
+    if (!_sched.ready)
+        return 0;
+    for (id = 0, m = 1; !(_sched.ready & m); id++, m <<= 1);
+    ev = _sched.ev[id];
+    _sched.ev[id] = 0;
+    _sched.ready &= ~m;
+    sei();
+    _sched.fn[id](ev);
+    return 1;
+}
+
+/* dispatch loop (never returns) */
+static inline void sched_run(void) {
+    sleep_set(SCHED_SLEEP);
+    for (;;) {
+        if (!sched_step()) {
+            sleep_en();
+            __asm__ __volatile__ ("sei" "\n\t" "sleep" "\n\t");
+            sleep_di();
+        }
+    }
+}
+
+
+#ifdef _SCHED_H_TEST_
+
+/* latency from timer1 compare event to handler in cycles (TCNT1 restarts at match, CTC F_CPU/1) */
+/* first 1000 events by superloop with 3 polled handlers of 100 cycles, then by scheduler */
+/* PORTB: worst superloop latency/4, PORTC: worst scheduler latency/4 */
+
+#include "timer1.h"
+
+static volatile uint8_t flag, phase;
+static uint16_t worst, n;
+
+static void event_task(uint8_t ev) {
+    uint16_t t = in(TCNT1);
+
+    (void)ev;
+    if (t > worst)
+        worst = t;
+    if (++n == 1000) {
+        PORTC = worst >> 2;
+        cbi(TIMSK, OCIE1A);
+    }
+}
+
+static void work_task(uint8_t ev) {
+    (void)ev;
+    __builtin_avr_delay_cycles(100);
+    sched_post(1, 1);  /* always ready, lowest priority */
+}
+
+int main(void) {
+    uint16_t t;
+
+    DDRB = ~0;
+    DDRC = ~0;
+
+    timer1_set(TIMER1_MODE_CTC_CMPA | TIMER1_CK_DIV1);
+    timer1_compareA(9999);
+    timer1_signal(TIMER1_INT_CMPA);
+    sei();
+
+    for (worst = 0, n = 0; n < 1000; ) {
+        if (flag) {
+            t = in(TCNT1);
+            flag = 0;
+            if (t > worst)
+                worst = t;
+            n++;
+        }
+        __builtin_avr_delay_cycles(100);  /* polled handlers */
+        __builtin_avr_delay_cycles(100);
+        __builtin_avr_delay_cycles(100);
+    }
+    PORTB = worst >> 2;
+
+    worst = 0;
+    n = 0;
+    phase = 1;
+    sched_add(0, event_task);
+    sched_add(1, work_task);
+    sched_post(1, 1);
+    sched_run();
+
+    return 0;
+}
+
+ISR_TIMER1_CMPA() {
+    if (phase) {
+        sched_post_isr(0, 1);
+    } else {
+        flag = 1;
+    }
+}
+
+#endif /* _SCHED_H_TEST_ */
+
+
+#endif /* _SCHED_H_ */
@@ -0,0 +1,400 @@
+/*
+ * SD/MMC card block device (SPI mode)
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Set MOSI and SCK as outputs, call sd_init() (chip select pin is
+ *   SD_CS_PORT/SD_CS_BIT, set as output by driver). Blocks are 512 bytes,
+ *   addressed by block number for all card types.
+ *
+ *   sd_init(): 80 clocks and CMD0/CMD8/ACMD41 (CMD1 for MMC) at
+ *   SPI_CK_DIV128, CMD58 for block addressing (SDHC) or CMD16 for 512 byte
+ *   blocks, then SPI_CK_DIV2 for data. Commands and tokens are sent byte by
+ *   byte (spi_data/spi_wait), data blocks with spi_write() and
+ *   spi_transfer() of spi.h (SPI_BULK_DIV 2 can be used).
+ *
+ *   sd_read(), sd_read_multi() (CMD17, CMD18): blocking until data is read.
+ *   sd_write() (CMD24) and sd_write_start()/sd_write_next()/sd_write_stop()
+ *   (CMD25 stream): return after card accepts the block, card is busy while
+ *   programming. sd_busy() polls one byte and returns at once, so main loop
+ *   can work during busy time; other functions wait until card is ready.
+ *
+ *   Chip select is high between calls, so other devices can use the bus
+ *   (also between blocks of a CMD25 stream). The driver uses spi.h directly
+ *   (not spi_master.h) and sets SPCR/SPSR in sd_init().
+ */
+
+
+#ifndef _SD_H_
+#define _SD_H_ 1
+
+
+#include "util.h"
+#include "spi.h"
+
+
+/* SD chip select pin */
+#ifndef SD_CS_PORT
+#define SD_CS_PORT  PORTB
+#define SD_CS_DDR   DDRB
+#ifdef __AVR_ATmega8__
+#define SD_CS_BIT   PB2  /* SS */
+#else /* !__AVR_ATmega8__ */
+#define SD_CS_BIT   PB4  /* SS */
+#endif /* __AVR_ATmega8__ */
+#endif /* SD_CS_PORT */
+
+/* SD card types (sd_type) */
+#define SD_TYPE_NONE  0  /* not initialized */
+#define SD_TYPE_MMC   1  /* MMC v3 */
+#define SD_TYPE_SD1   2  /* SD v1 */
+#define SD_TYPE_SD2   3  /* SD v2 byte addressed */
+#define SD_TYPE_SDHC  4  /* SD v2 block addressed (SDHC, SDXC) */
+
+#define SD_BLOCK  512  /* block size */
+
+/* SD commands */
+#define SD_CMD0   0   /* GO_IDLE_STATE */
+#define SD_CMD1   1   /* SEND_OP_COND (MMC) */
+#define SD_CMD8   8   /* SEND_IF_COND */
+#define SD_CMD12  12  /* STOP_TRANSMISSION */
+#define SD_CMD16  16  /* SET_BLOCKLEN */
+#define SD_CMD17  17  /* READ_SINGLE_BLOCK */
+#define SD_CMD18  18  /* READ_MULTIPLE_BLOCK */
+#define SD_CMD24  24  /* WRITE_BLOCK */
+#define SD_CMD25  25  /* WRITE_MULTIPLE_BLOCK */
+#define SD_CMD55  55  /* APP_CMD */
+#define SD_CMD58  58  /* READ_OCR */
+#define SD_ACMD41 41  /* SD_SEND_OP_COND (after CMD55) */
+
+/* SD responses and tokens */
+#define SD_R1_READY       0x00  /* R1 no error */
+#define SD_R1_IDLE        0x01  /* R1 idle state */
+#define SD_R1_ILLEGAL     0x04  /* R1 illegal command */
+#define SD_TOKEN_START    0xFE  /* start block (read, single write) */
+#define SD_TOKEN_MULTI    0xFC  /* start block (multi write) */
+#define SD_TOKEN_STOP     0xFD  /* stop multi write */
+#define SD_DATA_ACCEPTED  0x05  /* data response (masked 0x1F) */
+
+#define _SD_POLLS        (F_CPU/32)     /* busy and token polls (at least 500ms) */
+#define _SD_INIT_TRIES   (F_CPU/16384)  /* ACMD41 tries at SPI_CK_DIV128 (at least 1s) */
+
+
+/* SD state */
+static struct {
+    uint8_t type;  /* SD_TYPE_* */
+    uint8_t err;   /* last bad R1, token or data response */
+} _sd __attribute__((unused));
+
+
+/* SD macros */
+#define sd_type()      (_sd.type)                                   /* card type (SD_TYPE_*) */
+#define sd_error()     (_sd.err)                                    /* last bad response */
+#define _sd_select()   cbi(SD_CS_PORT, SD_CS_BIT)                   /* chip select low */
+#define _sd_deselect() {sbi(SD_CS_PORT, SD_CS_BIT); _sd_byte(0xFF);}  /* chip select high and release DO */
+#define _sd_addr(lba)  ((_sd.type == SD_TYPE_SDHC)? (lba): (lba) << 9)  /* block number to command address */
+
+
+/* send and receive one byte */
+static inline uint8_t _sd_byte(uint8_t b) {
+    spi_data(b);
+    spi_wait();
+    return spi_data_get();
+}
+
+/* wait until card is not busy, return 0 on timeout */
+static inline uint8_t _sd_ready(void) {
+    uint32_t n = _SD_POLLS;
+
+    while (_sd_byte(0xFF) != 0xFF) {
+        if (!--n)
+            return 0;
+    }
+    return 1;
+}
+
+/* send command, return R1 (0xFF on timeout) */
+static inline uint8_t _sd_cmd(uint8_t cmd, uint32_t arg) {
+    uint8_t i, r = 0xFF;
+
+    if (cmd != SD_CMD0 && cmd != SD_CMD12 && !_sd_ready())  /* CMD12 stops a running read */
+        return 0xFF;
+    _sd_byte(0x40 | cmd);
+    _sd_byte(arg >> 24);
+    _sd_byte(arg >> 16);
+    _sd_byte(arg >> 8);
+    _sd_byte(arg);
+    _sd_byte((cmd == SD_CMD0)? 0x95: (cmd == SD_CMD8)? 0x87: 0x01);  /* CRC only checked before CMD59 for CMD0 and CMD8 */
+    if (cmd == SD_CMD12)
+        _sd_byte(0xFF);  /* stuff byte */
+    for (i = 0; i < 10; i++) {
+        r = _sd_byte(0xFF);
+        if (!(r & 0x80))
+            break;
+    }
+    return r;
+}
+
+/* send application command */
+static inline uint8_t _sd_acmd(uint8_t cmd, uint32_t arg) {
+    _sd_cmd(SD_CMD55, 0);
+    return _sd_cmd(cmd, arg);
+}
+
+/* init sequence (card selected), return card type or SD_TYPE_NONE */
+static inline uint8_t _sd_init(void) {
+    uint8_t i, r, ocr[4];
+    uint16_t n;
+
+    for (i = 0; i < 10; i++) {
+        r = _sd_cmd(SD_CMD0, 0);
+        if (r == SD_R1_IDLE)
+            break;
+    }
+    if (r != SD_R1_IDLE) {
+        _sd.err = r;
+        return SD_TYPE_NONE;
+    }
+
+    if (_sd_cmd(SD_CMD8, 0x1AA) == SD_R1_IDLE) {
+        for (i = 0; i < 4; i++)
+            ocr[i] = _sd_byte(0xFF);
+        if (ocr[2] != 0x01 || ocr[3] != 0xAA)
+            return SD_TYPE_NONE;  /* voltage range not accepted */
+        for (n = _SD_INIT_TRIES; n; n--) {
+            r = _sd_acmd(SD_ACMD41, 0x40000000);  /* HCS */
+            if (r == SD_R1_READY)
+                break;
+        }
+        if (r != SD_R1_READY || (r = _sd_cmd(SD_CMD58, 0)) != SD_R1_READY) {
+            _sd.err = r;
+            return SD_TYPE_NONE;
+        }
+        for (i = 0; i < 4; i++)
+            ocr[i] = _sd_byte(0xFF);
+        return (ocr[0] & 0x40)? SD_TYPE_SDHC: SD_TYPE_SD2;  /* CCS */
+    }
+
+    i = (_sd_acmd(SD_ACMD41, 0) <= SD_R1_IDLE)? SD_TYPE_SD1: SD_TYPE_MMC;
+    for (n = _SD_INIT_TRIES; n; n--) {
+        r = (i == SD_TYPE_SD1)? _sd_acmd(SD_ACMD41, 0): _sd_cmd(SD_CMD1, 0);
+        if (r == SD_R1_READY)
+            break;
+    }
+    if (r != SD_R1_READY || (r = _sd_cmd(SD_CMD16, SD_BLOCK)) != SD_R1_READY) {
+        _sd.err = r;
+        return SD_TYPE_NONE;
+    }
+    return i;
+}
+
+/* init card, return card type or SD_TYPE_NONE (0) on error */
+static inline uint8_t sd_init(void) {
+    uint8_t i, type;
+
+    sbi(SD_CS_PORT, SD_CS_BIT);
+    sbi(SD_CS_DDR, SD_CS_BIT);
+    spi_set(SPI_MASTER | SPI_CK_DIV128);
+    spi_en();
+    for (i = 0; i < 10; i++)
+        _sd_byte(0xFF);  /* 80 clocks with chip select high */
+
+    _sd_select();
+    type = _sd_init();
+    _sd_deselect();
+
+    spi_set(SPI_MASTER | SPI_CK_DIV2);
+    spi_en();
+    _sd.type = type;
+    return type;
+}
+
+/* card is programming (one byte poll, does not wait) */
+static inline uint8_t sd_busy(void) {
+    uint8_t b;
+
+    _sd_select();
+    b = _sd_byte(0xFF);
+    _sd_deselect();
+    return b != 0xFF;
+}
+
+/* receive data block (card selected) */
+static inline uint8_t _sd_read_data(uint8_t *buf) {
+    uint32_t n = _SD_POLLS;
+    uint16_t i;
+    uint8_t t;
+
+    while ((t = _sd_byte(0xFF)) == 0xFF) {
+        if (!--n)
+            break;
+    }
+    if (t != SD_TOKEN_START) {
+        _sd.err = t;
+        return 0;
+    }
+    for (i = 0; i < SD_BLOCK; i++)
+        buf[i] = 0xFF;
+    spi_transfer(buf, buf, SD_BLOCK);  /* in place, sends 0xFF */
+    _sd_byte(0xFF);  /* CRC */
+    _sd_byte(0xFF);
+    return 1;
+}
+
+/* send data block with token (card selected), card is busy after return */
+static inline uint8_t _sd_write_data(uint8_t token, const uint8_t *buf) {
+    uint8_t r;
+
+    if (!_sd_ready())
+        return 0;
+    _sd_byte(token);
+    spi_write(buf, SD_BLOCK);
+    _sd_byte(0xFF);  /* CRC */
+    _sd_byte(0xFF);
+    r = _sd_byte(0xFF) & 0x1F;
+    if (r != SD_DATA_ACCEPTED) {
+        _sd.err = r;
+        return 0;
+    }
+    return 1;
+}
+
+/* read block, return 0 on error */
+static inline uint8_t sd_read(uint32_t lba, void *buf) {
+    uint8_t r, ok = 0;
+
+    _sd_select();
+    r = _sd_cmd(SD_CMD17, _sd_addr(lba));
+    if (r == SD_R1_READY)
+        ok = _sd_read_data((uint8_t *)buf);
+    else
+        _sd.err = r;
+    _sd_deselect();
+    return ok;
+}
+
+/* read n consecutive blocks, return 0 on error */
+static inline uint8_t sd_read_multi(uint32_t lba, void *buf, uint16_t n) {
+    uint8_t *p = (uint8_t *)buf;
+    uint8_t r, ok = 0;
+
+    _sd_select();
+    r = _sd_cmd(SD_CMD18, _sd_addr(lba));
+    if (r == SD_R1_READY) {
+        for (ok = 1; n && ok; n--, p += SD_BLOCK)
+            ok = _sd_read_data(p);
+        _sd_cmd(SD_CMD12, 0);
+    } else {
+        _sd.err = r;
+    }
+    _sd_deselect();
+    return ok;
+}
+
+/* write block, return 0 on error (card is busy after return, see sd_busy) */
+static inline uint8_t sd_write(uint32_t lba, const void *buf) {
+    uint8_t r, ok = 0;
+
+    _sd_select();
+    r = _sd_cmd(SD_CMD24, _sd_addr(lba));
+    if (r == SD_R1_READY)
+        ok = _sd_write_data(SD_TOKEN_START, (const uint8_t *)buf);
+    else
+        _sd.err = r;
+    _sd_deselect();
+    return ok;
+}
+
+/* start multi block write stream at block, return 0 on error */
+static inline uint8_t sd_write_start(uint32_t lba) {
+    uint8_t r;
+
+    _sd_select();
+    r = _sd_cmd(SD_CMD25, _sd_addr(lba));
+    _sd_deselect();
+    if (r != SD_R1_READY) {
+        _sd.err = r;
+        return 0;
+    }
+    return 1;
+}
+
+/* write next block of stream, return 0 on error (card is busy after return, see sd_busy) */
+static inline uint8_t sd_write_next(const void *buf) {
+    uint8_t ok;
+
+    _sd_select();
+    ok = _sd_write_data(SD_TOKEN_MULTI, (const uint8_t *)buf);
+    _sd_deselect();
+    return ok;
+}
+
+/* stop multi block write stream (card is busy after return, see sd_busy) */
+static inline uint8_t sd_write_stop(void) {
+    uint8_t ok;
+
+    _sd_select();
+    ok = _sd_ready();
+    if (ok) {
+        _sd_byte(SD_TOKEN_STOP);
+        _sd_byte(0xFF);  /* busy starts after one byte */
+    }
+    _sd_deselect();
+    return ok;
+}
+
+
+#ifdef _SD_H_TEST_
+
+/* write 4 blocks by CMD25 stream then read back block by block (one 512 byte buffer) */
+/* PORTA: card type - PORTC: 1 if read data is same - PORTD: busy polls/16 of last block */
+
+uint8_t buf[SD_BLOCK];
+
+int main(void) {
+    uint8_t ok, b;
+    uint16_t i, busy = 0;
+
+    DDRB = b1(PB5)|b1(PB7);  /* MOSI, SCK */
+    DDRA = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    PORTA = sd_init();
+
+    ok = sd_write_start(100);
+    for (b = 0; b < 4 && ok; b++) {
+        for (i = 0; i < SD_BLOCK; i++)
+            buf[i] = b+i;
+        ok = sd_write_next(buf);
+        for (busy = 0; sd_busy(); busy++);  /* CPU is free while card is busy */
+    }
+    sd_write_stop();
+    while (sd_busy());
+
+    for (b = 0; b < 4 && ok; b++) {
+        for (i = 0; i < SD_BLOCK; i++)
+            buf[i] = 0;
+        ok = sd_read(100+b, buf);
+        for (i = 0; i < SD_BLOCK && ok; i++)
+            if (buf[i] != (uint8_t)(b+i))
+                ok = 0;
+    }
+
+    PORTC = ok;
+    PORTD = busy >> 4;
+
+    for (;;);
+
+    return 0;
+}
+
+#endif /* _SD_H_TEST_ */
+
+
+#endif /* _SD_H_ */
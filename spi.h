@@ -1,8 +1,8 @@
 /*
  * Serial peripheral interface
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -72,8 +72,218 @@
 #define ISR_SPI_STC()  ISR(SPI_STC_vect)
 
 
+/*
+ * SPI bulk transfer (master, SPI interrupt off):
+ *
+ *   spi_transfer(tx, rx, len), spi_write(buf, len) and spi_fill(byte, len)
+ *   load next byte in a register while current byte is shifted, so SPDR is
+ *   written right after end of transfer. rx may be same as tx (in place).
+ *
+ *   SPI_BULK_DIV 0: SPIF is polled, works with any clock (gap of 2 ~ 5
+ *   cycles per byte, about 75% of bus rate at SPI_CK_DIV2).
+ *   SPI_BULK_DIV 2 or 4: no polling, SPDR is written every 9*SPI_BULK_DIV
+ *   cycles (8 SCK periods + one for prescaler phase), loop overhead is in
+ *   the wait time (89% of bus rate). spi_set() clock must be SPI_CK_DIV2 or
+ *   SPI_CK_DIV4 (a faster clock is safe, a slower one writes with collision).
+ *   Interrupts only make gaps longer: spi_transfer reads last byte before
+ *   next write (polled) or with interrupts off around write and read (timed).
+ */
+
+#ifndef SPI_BULK_DIV
+#define SPI_BULK_DIV  0
+#endif /* SPI_BULK_DIV */
+#if SPI_BULK_DIV != 0 && SPI_BULK_DIV != 2 && SPI_BULK_DIV != 4
+#error "SPI_BULK_DIV must be 0, 2 or 4"
+#endif
+
+#define _SPI_BULK_CYCLES  (9*SPI_BULK_DIV)  /* cycles between SPDR writes (timed) */
+#define _SPI_STR_(x)      #x
+#define _SPI_STR(x)       _SPI_STR_(x)
+#define _SPI_BULK_PAD(n)  ".rept " _SPI_STR(_SPI_BULK_CYCLES-(n)) "\n\t" "nop\n\t" ".endr\n\t"  /* pad loop of n cycles */
+
+
+#if SPI_BULK_DIV
+
+/* wait for last byte (timed, SPIF is not cleared between bytes) */
+#define _spi_bulk_end()  {__builtin_avr_delay_cycles(_SPI_BULK_CYCLES); (void)in(SPSR);}
+
+/* send len bytes of buf */
+static inline void spi_write(const void *buf, uint16_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+
+    if (!len)
+        return;
+    __asm__ __volatile__ (
+        "ld __tmp_reg__, Z+"           "\n\t"
+        "1: out %[spdr], __tmp_reg__"  "\n\t"  /* 1 */
+        "sbiw %[len], 1"               "\n\t"  /* 2 */
+        "breq 2f"                      "\n\t"  /* 1 */
+        "ld __tmp_reg__, Z+"           "\n\t"  /* 2 */
+        _SPI_BULK_PAD(8)
+        "rjmp 1b"                      "\n\t"  /* 2 */
+        "2:"                           "\n\t"
+        : "+z" (p), [len] "+w" (len)
+        : [spdr] "I" (_SFR_IO_ADDR(SPDR))
+        : "memory");
+    _spi_bulk_end();
+    (void)in(SPDR);
+}
+
+/* send len bytes of tx and receive to rx */
+static inline void spi_transfer(const void *tx, void *rx, uint16_t len) {
+    const uint8_t *t = (const uint8_t *)tx;
+    uint8_t *r = (uint8_t *)rx;
+    uint8_t s;
+
+    if (!len)
+        return;
+    __asm__ __volatile__ (
+        "ld __tmp_reg__, Z+"           "\n\t"
+        "out %[spdr], __tmp_reg__"     "\n\t"
+        "rjmp .+0"                     "\n\t"  /* same time as in, out, st and rjmp */
+        "rjmp .+0"                     "\n\t"
+        "rjmp .+0"                     "\n\t"
+        "1: sbiw %[len], 1"            "\n\t"  /* 2 */
+        "breq 2f"                      "\n\t"  /* 1 */
+        "ld __tmp_reg__, Z+"           "\n\t"  /* 2 */
+        "in %[s], %[sreg]"             "\n\t"  /* 1 */
+        _SPI_BULK_PAD(14)
+        "cli"                          "\n\t"  /* 1: no ISR between next byte and read of last one */
+        "out %[spdr], __tmp_reg__"     "\n\t"  /* 1: next byte */
+        "in __tmp_reg__, %[spdr]"      "\n\t"  /* 1: last byte */
+        "out %[sreg], %[s]"            "\n\t"  /* 1 */
+        "st X+, __tmp_reg__"           "\n\t"  /* 2 */
+        "rjmp 1b"                      "\n\t"  /* 2 */
+        "2:"                           "\n\t"
+        : "+z" (t), "+x" (r), [len] "+w" (len), [s] "=&r" (s)
+        : [spdr] "I" (_SFR_IO_ADDR(SPDR)), [sreg] "I" (_SFR_IO_ADDR(SREG))
+        : "memory");
+    _spi_bulk_end();
+    *r = in(SPDR);
+}
+
+/* send byte len times */
+static inline void spi_fill(uint8_t byte, uint16_t len) {
+    if (!len)
+        return;
+    __asm__ __volatile__ (
+        "1: out %[spdr], %[byte]"      "\n\t"  /* 1 */
+        "sbiw %[len], 1"               "\n\t"  /* 2 */
+        "breq 2f"                      "\n\t"  /* 1 */
+        _SPI_BULK_PAD(6)
+        "rjmp 1b"                      "\n\t"  /* 2 */
+        "2:"                           "\n\t"
+        : [len] "+w" (len)
+        : [spdr] "I" (_SFR_IO_ADDR(SPDR)), [byte] "r" (byte));
+    _spi_bulk_end();
+    (void)in(SPDR);
+}
+
+#else /* !SPI_BULK_DIV */
+
+/* send len bytes of buf */
+static inline void spi_write(const void *buf, uint16_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint8_t b;
+
+    if (!len)
+        return;
+    out(SPDR, *p++);
+    while (--len) {
+        b = *p++;  /* load next byte while shifting */
+        spi_wait();
+        out(SPDR, b);
+    }
+    spi_wait();
+    (void)in(SPDR);
+}
+
+/* send len bytes of tx and receive to rx */
+static inline void spi_transfer(const void *tx, void *rx, uint16_t len) {
+    const uint8_t *t = (const uint8_t *)tx;
+    uint8_t *r = (uint8_t *)rx;
+    uint8_t b, c;
+
+    if (!len)
+        return;
+    out(SPDR, *t++);
+    while (--len) {
+        b = *t++;  /* load next byte while shifting */
+        spi_wait();
+        c = in(SPDR);  /* read before next write, an ISR between them only makes a gap */
+        out(SPDR, b);
+        *r++ = c;
+    }
+    spi_wait();
+    *r = in(SPDR);
+}
+
+/* send byte len times */
+static inline void spi_fill(uint8_t byte, uint16_t len) {
+    if (!len)
+        return;
+    out(SPDR, byte);
+    while (--len) {
+        spi_wait();
+        out(SPDR, byte);
+    }
+    spi_wait();
+    (void)in(SPDR);
+}
+
+#endif /* SPI_BULK_DIV */
+
+
 #ifdef _SPI_H_TEST_
 
+#ifdef SPI_TEST_BULK
+
+/* SPI_TEST_BULK: cycles per byte (timer1 at F_CPU/1) of 64 bytes at SPI_CK_DIV2 (16 cycles per byte on bus) */
+/* PORTA: spi_data/spi_wait loop - PORTB: spi_write - PORTC: spi_transfer - PORTD: spi_fill */
+
+uint8_t buf[64];
+
+int main(void) {
+    uint8_t i;
+    uint16_t t;
+
+    DDRA = ~0;
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+
+    spi_set(SPI_MASTER | SPI_CK_DIV2);
+    spi_en();
+    TCCR1B = b1(CS10);
+
+    for (;;) {
+        t = in(TCNT1);
+        for (i = 0; i < sizeof(buf); i++) {
+            spi_data(buf[i]);
+            spi_wait();
+        }
+        PORTA = (in(TCNT1)-t)/sizeof(buf);
+
+        t = in(TCNT1);
+        spi_write(buf, sizeof(buf));
+        PORTB = (in(TCNT1)-t)/sizeof(buf);
+
+        t = in(TCNT1);
+        spi_transfer(buf, buf, sizeof(buf));
+        PORTC = (in(TCNT1)-t)/sizeof(buf);
+
+        t = in(TCNT1);
+        spi_fill(0xFF, sizeof(buf));
+        PORTD = (in(TCNT1)-t)/sizeof(buf);
+    }
+
+    return 0;
+}
+
+#else /* !SPI_TEST_BULK */
+
 int main(void) {
     uint8_t i = 0;
 
@@ -92,6 +302,8 @@ int main(void) {
 
 ISR_SPI_STC() {}
 
+#endif /* SPI_TEST_BULK */
+
 #endif /* _SPI_H_TEST_ */
 
 
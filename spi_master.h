@@ -0,0 +1,230 @@
+/*
+ * Interrupt driven SPI master with device registry
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Describe each device with spi_dev_set() (chip select pin and spi_set()
+ *   options: SPI_CK_DIVx, SPI_CK_POLARITY, SPI_CK_PHASE, SPI_DATA_ORDER),
+ *   call spi_master_en() and forward the SPI interrupt:
+ *
+ *     ISR_SPI_STC() {spi_master_isr();}
+ *
+ *   Transactions are queued by spi_master_xfer() and run one after other by
+ *   the ISR (one interrupt per byte), so main loop and other ISRs are free
+ *   during transfers. SPCR and SPSR are written only when device changes.
+ *   Chip select is low for the whole transaction; with SPI_XFER_KEEP it stays
+ *   low for next transaction of same device (e.g. command then data).
+ *
+ *   Transaction status is SPI_XFER_WAIT until done, then the optional done
+ *   callback is called from ISR (keep it short). Transaction memory and
+ *   buffers must be valid until done. tx 0 sends 0xFF, rx 0 drops received
+ *   bytes, len must be 1 ~ 65535.
+ *
+ *   SS pin must be output (or input with high level), else master mode is
+ *   lost. ISR takes about 80 cycles per byte with entry and exit, so bus rate
+ *   is limited to about F_CPU/10 bit/s, use spi_transfer() of spi.h for
+ *   blocking bulk transfers.
+ */
+
+
+#ifndef _SPI_MASTER_H_
+#define _SPI_MASTER_H_ 1
+
+
+#include "util.h"
+#include "spi.h"
+
+
+/* SPI master options */
+#ifndef SPI_MASTER_QUEUE
+#define SPI_MASTER_QUEUE  4  /* queued transactions (power of two) */
+#endif /* SPI_MASTER_QUEUE */
+
+/* SPI transaction flags (spi_xfer.flags) */
+#define SPI_XFER_KEEP  b1(0)  /* keep chip select low after transaction */
+
+/* SPI transaction status (spi_xfer.status) */
+#define SPI_XFER_WAIT  0  /* queued or in transfer */
+#define SPI_XFER_OK    1  /* done */
+
+
+/* SPI device */
+typedef struct spi_dev {
+    volatile uint8_t *port;  /* chip select port (PORTx) */
+    uint8_t cs;              /* chip select bit mask */
+    uint8_t spcr;            /* SPCR value */
+    uint8_t spsr;            /* SPSR value */
+} spi_dev_t;
+
+/* SPI transaction */
+typedef struct spi_xfer {
+    spi_dev_t *dev;                     /* target device */
+    const uint8_t *tx;                  /* send data or 0 (0xFF) */
+    uint8_t *rx;                        /* receive data or 0 */
+    uint16_t len;                       /* length */
+    uint8_t flags;                      /* SPI_XFER_* */
+    volatile uint8_t status;            /* SPI_XFER_* */
+    void (*done)(struct spi_xfer *xfr); /* done callback (from ISR) or 0 */
+} spi_xfer_t;
+
+
+/* SPI master state */
+static struct {
+    FIFO(spi_xfer_t *, SPI_MASTER_QUEUE) queue;  /* producer: main - consumer: ISR */
+    spi_xfer_t *xfer;                            /* current transaction (ISR only) */
+    spi_dev_t *dev;                              /* device of SPCR/SPSR */
+    spi_dev_t *sel;                              /* device with chip select low (SPI_XFER_KEEP) */
+    uint16_t idx;                                /* current byte (ISR only) */
+    volatile uint8_t busy;                       /* ISR is running transactions */
+} _spi_master __attribute__((unused));
+
+
+/* SPI master macros */
+#define spi_master_en()    {fifo_clear(_spi_master.queue); _spi_master.xfer = 0; _spi_master.dev = 0; _spi_master.sel = 0; _spi_master.busy = 0;}  /* reset queue */
+#define spi_master_busy()  (_spi_master.busy)                  /* transactions in transfer */
+#define spi_master_wait()  {while (spi_master_busy());}        /* wait to all transactions done */
+#define spi_xfer_done(xfr) ((xfr)->status != SPI_XFER_WAIT)    /* transaction is done */
+#define spi_xfer_wait(xfr) {while (!spi_xfer_done(xfr));}      /* wait to transaction done */
+
+
+/* setup device: chip select port (e.g. &PORTB) and bit, spi_set() options */
+static inline void spi_dev_set(spi_dev_t *dev, volatile uint8_t *port, uint8_t bit, uint16_t cnt) {
+    dev->port = port;
+    dev->cs = b1(bit);
+    dev->spcr = (cnt & 0xFF) | b1(SPIE) | b1(SPE) | b1(MSTR);
+    dev->spsr = cnt >> 8;
+    *port |= dev->cs;       /* deselect */
+    *(port-1) |= dev->cs;   /* DDRx is below PORTx */
+}
+
+/* start next transaction or idle (ISR or main when idle) */
+static inline void _spi_master_next(void) {
+    spi_xfer_t *xfr;
+    spi_dev_t *dev;
+
+    if (!fifo_pop(_spi_master.queue, &xfr)) {
+        _spi_master.xfer = 0;
+        _spi_master.busy = 0;
+        return;
+    }
+    dev = xfr->dev;
+    if (_spi_master.sel && _spi_master.sel != dev) {
+        *_spi_master.sel->port |= _spi_master.sel->cs;  /* kept device is deselected */
+        _spi_master.sel = 0;
+    }
+    if (_spi_master.dev != dev) {
+        _spi_master.dev = dev;
+        out(SPCR, dev->spcr);
+        out(SPSR, dev->spsr);
+    }
+    *dev->port &= ~dev->cs;
+    _spi_master.xfer = xfr;
+    _spi_master.idx = 0;
+    out(SPDR, xfr->tx? xfr->tx[0]: 0xFF);
+}
+
+/* queue transaction, return 0 if queue is full */
+static inline uint8_t spi_master_submit(spi_xfer_t *xfr) {
+    xfr->status = SPI_XFER_WAIT;
+    if (!fifo_push(_spi_master.queue, xfr))
+        return 0;
+    if (!_spi_master.busy) {
+        _spi_master.busy = 1;
+        _spi_master_next();
+    }
+    return 1;
+}
+
+/* queue transaction of len bytes to device */
+static inline uint8_t spi_master_xfer(spi_xfer_t *xfr, spi_dev_t *dev, const void *tx, void *rx, uint16_t len, uint8_t flags, void (*done)(spi_xfer_t *)) {
+    xfr->dev = dev;
+    xfr->tx = (const uint8_t *)tx;
+    xfr->rx = (uint8_t *)rx;
+    xfr->len = len;
+    xfr->flags = flags;
+    xfr->done = done;
+    return spi_master_submit(xfr);
+}
+
+/* SPI master handler (call from ISR_SPI_STC) */
+static inline void spi_master_isr(void) {
+    spi_xfer_t *xfr = _spi_master.xfer;
+    uint16_t idx = _spi_master.idx;
+    uint8_t b = in(SPDR);
+
+    if (!xfr)
+        return;
+    if (xfr->rx)
+        xfr->rx[idx] = b;
+    if (++idx < xfr->len) {
+        out(SPDR, xfr->tx? xfr->tx[idx]: 0xFF);
+        _spi_master.idx = idx;
+        return;
+    }
+
+    if (xfr->flags & SPI_XFER_KEEP)
+        _spi_master.sel = xfr->dev;
+    else
+        *xfr->dev->port |= xfr->dev->cs;
+    xfr->status = SPI_XFER_OK;
+    if (xfr->done)
+        xfr->done(xfr);
+    _spi_master_next();
+}
+
+
+#ifdef _SPI_MASTER_H_TEST_
+
+/* 512 bytes to device on PB4 (mode 0, F_CPU/4) and 2 bytes from device on PB3 (mode 3, F_CPU/16, LSB first) */
+/* PORTC counts in main loop during transfers, PORTD shows completed transactions */
+
+uint8_t block[512];
+uint8_t reg[2];
+spi_dev_t sd, adc;
+spi_xfer_t x1, x2;
+volatile uint8_t done = 0;
+
+void on_done(spi_xfer_t *x) {
+    (void)x;
+    done++;
+}
+
+int main(void) {
+    uint8_t count = 0;
+
+    DDRB = b1(PB5)|b1(PB7);  /* MOSI, SCK */
+    PORTC = 0;
+    DDRC = ~0;
+    PORTD = 0;
+    DDRD = ~0;
+
+    spi_dev_set(&sd, &PORTB, PB4, SPI_CK_DIV4);
+    spi_dev_set(&adc, &PORTB, PB3, SPI_CK_DIV16 | SPI_CK_POLARITY | SPI_CK_PHASE | SPI_DATA_ORDER);
+    spi_master_en();
+    sei();
+
+    spi_master_xfer(&x1, &sd, block, 0, sizeof(block), 0, on_done);
+    spi_master_xfer(&x2, &adc, 0, reg, sizeof(reg), 0, on_done);
+
+    while (spi_master_busy())
+        PORTC = ++count;  /* CPU is free during transfer */
+    PORTD = done;
+
+    for (;;);
+
+    return 0;
+}
+
+ISR_SPI_STC() {
+    spi_master_isr();
+}
+
+#endif /* _SPI_MASTER_H_TEST_ */
+
+
+#endif /* _SPI_MASTER_H_ */
@@ -0,0 +1,226 @@
+/*
+ * SPI slave with preloaded response FIFO
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Set MISO pin as output, call spi_slave_en() with clock mode options
+ *   (SPI_CK_POLARITY, SPI_CK_PHASE, SPI_DATA_ORDER) and put SPI_SLAVE_ISR()
+ *   in one source file (file scope, not ISR_SPI_STC). FIFOs are static in
+ *   header, so spi_slave_frame() and spi_slave_respond() must be called from
+ *   that source file too.
+ *
+ *   SPI_SLAVE_ISR is naked and writes the next TX byte (computed by last
+ *   interrupt) to SPDR as first work, then jumps to the C handler which
+ *   puts received byte to RX ring and takes next TX byte from TX FIFO
+ *   (SPI_SLAVE_IDLE if empty). So a queued byte is sent one transfer later.
+ *
+ *   Framing: master sends [cmd][len][len bytes], cmd SPI_SLAVE_IDLE is
+ *   ignored (master polls with it). spi_slave_frame() collects a frame in
+ *   main loop, spi_slave_respond() queues [len][len bytes] response. Master
+ *   clocks SPI_SLAVE_IDLE until a byte other than SPI_SLAVE_IDLE (response
+ *   length) is received.
+ *
+ *   Timing (cycles from instruction listing, avr-gcc -Os):
+ *     - SPDR is written 12 cycles after end of transfer (interrupt response,
+ *       vector jump, push, lds, out), plus latency of other ISRs and cli.
+ *     - Whole interrupt takes about 100 cycles.
+ *     - Slave SCK must be below F_CPU/4.
+ *   So master needs a gap of at least 12 cycles (plus other ISRs) between
+ *   bytes and a byte period (8 SCK + gap) of at least 100 cycles:
+ *
+ *     F_CPU    max SCK   min gap   max byte rate
+ *     1MHz     250KHz    12us      10KB/s
+ *     8MHz     2MHz      1.5us     80KB/s
+ *     16MHz    4MHz      0.75us    160KB/s
+ *     20MHz    5MHz      0.6us     200KB/s
+ */
+
+
+#ifndef _SPI_SLAVE_H_
+#define _SPI_SLAVE_H_ 1
+
+
+#include "util.h"
+#include "spi.h"
+
+
+/* SPI slave options */
+#ifndef SPI_SLAVE_RX_SIZE
+#define SPI_SLAVE_RX_SIZE  32  /* RX ring size (power of two, <= 128) */
+#endif /* SPI_SLAVE_RX_SIZE */
+#ifndef SPI_SLAVE_TX_SIZE
+#define SPI_SLAVE_TX_SIZE  32  /* TX FIFO size (power of two, <= 128) */
+#endif /* SPI_SLAVE_TX_SIZE */
+#ifndef SPI_SLAVE_FRAME
+#define SPI_SLAVE_FRAME    16  /* max frame data (longer data is dropped) */
+#endif /* SPI_SLAVE_FRAME */
+#ifndef SPI_SLAVE_IDLE
+#define SPI_SLAVE_IDLE     0xFF  /* sent when TX FIFO is empty */
+#endif /* SPI_SLAVE_IDLE */
+
+#if SPI_SLAVE_RX_SIZE > 128 || SPI_SLAVE_TX_SIZE > 128
+#error "SPI_SLAVE_RX_SIZE and SPI_SLAVE_TX_SIZE must be <= 128 (8bit index)"
+#endif
+
+
+/* SPI slave state */
+static struct {
+    FIFO(uint8_t, SPI_SLAVE_RX_SIZE) rx;  /* producer: ISR - consumer: main */
+    FIFO(uint8_t, SPI_SLAVE_TX_SIZE) tx;  /* producer: main - consumer: ISR */
+    volatile uint8_t next;                /* preloaded by naked ISR */
+    volatile uint8_t overrun;             /* dropped received bytes */
+    uint8_t state;                        /* frame state (main only) */
+    uint8_t cmd;                          /* frame command (main only) */
+    uint8_t len;                          /* frame length (main only) */
+    uint8_t idx;                          /* received frame bytes (main only) */
+    uint8_t data[SPI_SLAVE_FRAME];        /* frame data (main only) */
+} _spi_slave __attribute__((unused));
+
+
+/* SPI slave macros */
+#define spi_slave_available()      fifo_count(_spi_slave.rx)          /* received bytes in ring */
+#define spi_slave_free()           fifo_space(_spi_slave.tx)          /* free space in TX FIFO */
+#define spi_slave_overrun()        (_spi_slave.overrun)               /* dropped received bytes */
+#define spi_slave_overrun_clear()  {_spi_slave.overrun = 0;}          /* clear dropped counter */
+#define spi_slave_cmd()            (_spi_slave.cmd)                   /* frame command (after spi_slave_frame) */
+#define spi_slave_len()            (_spi_slave.len < SPI_SLAVE_FRAME? _spi_slave.len: SPI_SLAVE_FRAME)  /* frame stored data length */
+#define spi_slave_data()           ((const uint8_t *)_spi_slave.data) /* frame data */
+#define spi_slave_di()             spi_set(0)                         /* disable */
+
+
+/* enable slave with clock mode options (SPI_CK_POLARITY, SPI_CK_PHASE, SPI_DATA_ORDER) */
+static inline void spi_slave_en(uint8_t cnt) {
+    fifo_clear(_spi_slave.rx);
+    fifo_clear(_spi_slave.tx);
+    _spi_slave.next = SPI_SLAVE_IDLE;
+    _spi_slave.overrun = 0;
+    _spi_slave.state = 0;
+    spi_set(SPI_SLAVE | SPI_INT_STC | b1(SPE) | cnt);
+    out(SPDR, SPI_SLAVE_IDLE);
+}
+
+/* queue byte to send, return 0 if TX FIFO is full */
+static inline uint8_t spi_slave_write(uint8_t b) {
+    return fifo_push(_spi_slave.tx, b);
+}
+
+/* read received byte, return -1 if ring is empty */
+static inline int16_t spi_slave_read(void) {
+    uint8_t b;
+
+    if (!fifo_pop(_spi_slave.rx, &b))
+        return -1;
+    return b;
+}
+
+/* collect received bytes to frame, return 1 when a [cmd][len][data] frame is complete */
+static inline uint8_t spi_slave_frame(void) {
+    uint8_t b;
+
+    while (fifo_pop(_spi_slave.rx, &b)) {
+        switch (_spi_slave.state) {
+        case 0:
+            if (b == SPI_SLAVE_IDLE)
+                break;  /* master polls */
+            _spi_slave.cmd = b;
+            _spi_slave.state = 1;
+            break;
+        case 1:
+            _spi_slave.len = b;
+            _spi_slave.idx = 0;
+            _spi_slave.state = 2;
+            break;
+        default:
+            if (_spi_slave.idx < SPI_SLAVE_FRAME)
+                _spi_slave.data[_spi_slave.idx] = b;
+            _spi_slave.idx++;
+            break;
+        }
+        if (_spi_slave.state == 2 && _spi_slave.idx >= _spi_slave.len) {
+            _spi_slave.state = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* queue [len][data] response, return 0 if TX FIFO has no space (nothing queued) */
+static inline uint8_t spi_slave_respond(const void *buf, uint8_t len) {
+    if (len == SPI_SLAVE_IDLE || fifo_space(_spi_slave.tx) < len+1)
+        return 0;
+    fifo_push(_spi_slave.tx, len);
+    fifo_push_block(_spi_slave.tx, (const uint8_t *)buf, len);
+    return 1;
+}
+
+/* SPI slave handler (called by SPI_SLAVE_ISR after preload) */
+static inline void spi_slave_isr(void) {
+    uint8_t b = in(SPDR);
+
+    if (!fifo_push(_spi_slave.rx, b))
+        _spi_slave.overrun++;
+    if (!fifo_pop(_spi_slave.tx, &b))
+        b = SPI_SLAVE_IDLE;
+    _spi_slave.next = b;
+}
+
+/* SPI slave ISR (naked preload then C handler) */
+#define SPI_SLAVE_ISR() \
+void __vector_spi_slave(void) __attribute__((signal, used)); \
+ISR(SPI_STC_vect, ISR_NAKED) { \
+    __asm__ __volatile__ ( \
+        "push r24"        "\n\t" \
+        "lds r24, %0"     "\n\t" \
+        "out %1, r24"     "\n\t" \
+        "pop r24"         "\n\t" \
+        "%~jmp __vector_spi_slave" "\n\t" \
+        :: "i" (&_spi_slave.next), "I" (_SFR_IO_ADDR(SPDR))); \
+} \
+void __vector_spi_slave(void) { \
+    spi_slave_isr(); \
+}
+
+
+#ifdef _SPI_SLAVE_H_TEST_
+
+/* command 0x01 echoes data reversed, other commands answer with empty response */
+/* PORTC shows received frames, PORTD shows dropped bytes */
+
+SPI_SLAVE_ISR()
+
+int main(void) {
+    uint8_t i, n, frames = 0;
+    uint8_t buf[SPI_SLAVE_FRAME];
+
+    DDRB = b1(PB6);  /* MISO */
+    PORTC = 0;
+    DDRC = ~0;
+    PORTD = 0;
+    DDRD = ~0;
+
+    spi_slave_en(0);
+    sei();
+
+    for (;;) {
+        if (spi_slave_frame()) {
+            n = (spi_slave_cmd() == 0x01)? spi_slave_len(): 0;
+            for (i = 0; i < n; i++)
+                buf[i] = spi_slave_data()[n-1-i];
+            while (!spi_slave_respond(buf, n));
+            PORTC = ++frames;
+        }
+        PORTD = spi_slave_overrun();
+    }
+
+    return 0;
+}
+
+#endif /* _SPI_SLAVE_H_TEST_ */
+
+
+#endif /* _SPI_SLAVE_H_ */
@@ -1,8 +1,8 @@
 /*
  * Store program memory (boot loader)
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -44,6 +44,14 @@
 #define spm_wait()        wait_clear_bit(SPMCR, SPMEN)      /* wait to end */
 #define spm_rww_wait()    wait_clear_bit(SPMCR, RWWSB)      /* wait to RWW end */
 #define spm_rww_en()      smi(SPMCR, b1(RWWSB)|b1(RWWSRE))  /* RWW enable */
+#define spm_busy()        bis(SPMCR, SPMEN)                 /* SPM operation is running */
+
+/* SPM operation on byte address (SPMCR then spm in 4 cycles, code must be in boot section, interrupts off) */
+#define spm_cmd(adr, cmd)  {__asm__ __volatile__ ("out %0, %1" "\n\t" "spm" "\n\t" :: "I" (_SFR_IO_ADDR(SPMCR)), "r" ((uint8_t)(cmd)), "z" ((uint16_t)(adr)));}
+#define spm_page_fill(adr, wrd)  {__asm__ __volatile__ ("movw r0, %2" "\n\t" "out %0, %1" "\n\t" "spm" "\n\t" "clr r1" "\n\t" :: "I" (_SFR_IO_ADDR(SPMCR)), "r" ((uint8_t)b1(SPMEN)), "r" ((uint16_t)(wrd)), "z" ((uint16_t)(adr)) : "r0");}  /* fill word of page buffer */
+#define spm_page_erase(adr)  spm_cmd(adr, b1(PGERS)|b1(SPMEN))   /* erase page (RWW section runs in background) */
+#define spm_page_write(adr)  spm_cmd(adr, b1(PGWRT)|b1(SPMEN))   /* write page buffer to page */
+#define spm_rww_read_en()    spm_cmd(0, b1(RWWSRE)|b1(SPMEN))    /* enable RWW section read after erase or write */
 
 
 /* SPM ready ISR */
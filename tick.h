@@ -0,0 +1,211 @@
+/*
+ * System tick (1ms) with millis and micros
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Put TICK_ISR() in source file (file scope), call tick_en() and enable
+ *   interrupts. tick_millis() and tick_micros() return 32bit monotonic time.
+ *   Counter is static in header (each source file has its own copy), so ISR
+ *   and all readers must be in that one source file (or its headers).
+ *
+ *   Timer0 in CTC mode (TIMER0_MODE_CTC) makes one compare match every 1ms.
+ *   ATmega8 has no OCR0, so timer2 in CTC mode (TIMER2_MODE_CTC) is used.
+ *
+ *   TICK_ISR is naked and increments the 32bit counter in assembly: 21 cycles
+ *   from first instruction to reti, 28 with interrupt response and vector jump
+ *   (without carry to upper bytes, 255 of 256 ticks).
+ *
+ *   tick_micros() reads counter and timer value with interrupts off and
+ *   checks the compare flag, so a match which is pending but not yet
+ *   serviced is counted (no backward step). For exact time F_CPU must be a
+ *   multiple of 1000*prescaler (e.g. 1, 2, 8 and 16MHz; not 20MHz, nor 4MHz
+ *   with timer0), otherwise a #warning tells that tick drifts.
+ */
+
+
+#ifndef _TICK_H_
+#define _TICK_H_ 1
+
+
+#include "util.h"
+#include "timer0.h"
+#include "timer2.h"
+
+
+/* tick timer prescaler (smallest with top <= 256) */
+#ifdef OCR0
+#if F_CPU/1000 <= 256
+#define TICK_DIV  1
+#define TICK_CK   TIMER0_CK_DIV1
+#elif F_CPU/8/1000 <= 256
+#define TICK_DIV  8
+#define TICK_CK   TIMER0_CK_DIV8
+#elif F_CPU/64/1000 <= 256
+#define TICK_DIV  64
+#define TICK_CK   TIMER0_CK_DIV64
+#elif F_CPU/256/1000 <= 256
+#define TICK_DIV  256
+#define TICK_CK   TIMER0_CK_DIV256
+#else
+#define TICK_DIV  1024
+#define TICK_CK   TIMER0_CK_DIV1024
+#endif
+#else /* !OCR0 */
+#if F_CPU/1000 <= 256
+#define TICK_DIV  1
+#define TICK_CK   TIMER2_CK_DIV1
+#elif F_CPU/8/1000 <= 256
+#define TICK_DIV  8
+#define TICK_CK   TIMER2_CK_DIV8
+#elif F_CPU/32/1000 <= 256
+#define TICK_DIV  32
+#define TICK_CK   TIMER2_CK_DIV32
+#elif F_CPU/64/1000 <= 256
+#define TICK_DIV  64
+#define TICK_CK   TIMER2_CK_DIV64
+#elif F_CPU/128/1000 <= 256
+#define TICK_DIV  128
+#define TICK_CK   TIMER2_CK_DIV128
+#else
+#define TICK_DIV  256
+#define TICK_CK   TIMER2_CK_DIV256
+#endif
+#endif /* OCR0 */
+
+#define TICK_TOP    (F_CPU/TICK_DIV/1000)                     /* timer counts in 1ms */
+#define _TICK_US8   ((uint32_t)(TICK_DIV*256000000ULL/F_CPU))  /* microseconds per timer count (8bit fixed point) */
+
+#if F_CPU % (TICK_DIV*1000)
+#warning "F_CPU is not multiple of 1000*TICK_DIV, tick drifts"
+#endif
+
+
+/* tick timer registers */
+#ifdef OCR0
+#define _TICK_TCNT     TCNT0
+#define _TICK_OCF      OCF0
+#define _TICK_VECT     TIMER0_COMP_vect
+#define _tick_timer()  {timer0_set(TIMER0_MODE_CTC | TICK_CK); timer0_compare(TICK_TOP-1); timer0_value(0); timer0_signal(TIMER0_INT_CMP);}
+#else /* !OCR0 */
+#define _TICK_TCNT     TCNT2
+#define _TICK_OCF      OCF2
+#define _TICK_VECT     TIMER2_COMP_vect
+#define _tick_timer()  {timer2_set(TIMER2_MODE_CTC | TICK_CK); timer2_compare(TICK_TOP-1); timer2_value(0); timer2_signal(TIMER2_INT_CMP);}
+#endif /* OCR0 */
+
+
+/* tick counter (milliseconds) */
+static volatile uint32_t _tick_ms __attribute__((unused));
+
+
+/* tick macros */
+#define tick_en()  {_tick_ms = 0; _tick_timer();}  /* start 1ms tick */
+
+
+/* tick compare match ISR (naked, 21 cycles) */
+#define TICK_ISR()  ISR(_TICK_VECT, ISR_NAKED) { \
+    __asm__ __volatile__ ( \
+        "push r24"        "\n\t" \
+        "in r24, __SREG__" "\n\t" \
+        "push r24"        "\n\t" \
+        "lds r24, %0"     "\n\t" \
+        "subi r24, 0xFF"  "\n\t" \
+        "sts %0, r24"     "\n\t" \
+        "brne 1f"         "\n\t" \
+        "lds r24, %1"     "\n\t" \
+        "subi r24, 0xFF"  "\n\t" \
+        "sts %1, r24"     "\n\t" \
+        "brne 1f"         "\n\t" \
+        "lds r24, %2"     "\n\t" \
+        "subi r24, 0xFF"  "\n\t" \
+        "sts %2, r24"     "\n\t" \
+        "brne 1f"         "\n\t" \
+        "lds r24, %3"     "\n\t" \
+        "subi r24, 0xFF"  "\n\t" \
+        "sts %3, r24"     "\n\t" \
+        "1: pop r24"      "\n\t" \
+        "out __SREG__, r24" "\n\t" \
+        "pop r24"         "\n\t" \
+        "reti"            "\n\t" \
+        :: "i" ((uint8_t *)&_tick_ms), "i" ((uint8_t *)&_tick_ms+1), \
+           "i" ((uint8_t *)&_tick_ms+2), "i" ((uint8_t *)&_tick_ms+3)); \
+}
+
+
+/* milliseconds since tick_en */
+static inline uint32_t tick_millis(void) {
+    uint32_t ms;
+    uint8_t f, s = in(SREG);
+
+    cli();
+    ms = _tick_ms;
+    f = bis(TIFR, _TICK_OCF);
+    out(SREG, s);
+    return f? ms+1: ms;  /* pending compare match */
+}
+
+/* microseconds since tick_en (resolution: TICK_DIV cycles) */
+static inline uint32_t tick_micros(void) {
+    uint32_t ms;
+    uint8_t t, f, s = in(SREG);
+
+    cli();
+    ms = _tick_ms;
+    t = in(_TICK_TCNT);
+    f = bis(TIFR, _TICK_OCF);
+    out(SREG, s);
+    if (f && t < TICK_TOP/2)
+        ms++;  /* pending compare match before timer read */
+    return ms*1000+(((uint32_t)t*_TICK_US8) >> 8);
+}
+
+/* wait ms milliseconds (interrupts must be enabled) */
+static inline void tick_delay(uint32_t ms) {
+    uint32_t t = tick_millis();
+
+    while (tick_millis()-t < ms);
+}
+
+
+#ifdef _TICK_H_TEST_
+
+/* PORTB toggles every 1s by millis, PORTC every 1s by micros (compare with simulated clock for drift) */
+
+TICK_ISR()
+
+int main(void) {
+    uint32_t ms, us;
+
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    tick_en();
+    sei();
+
+    ms = tick_millis();
+    us = tick_micros();
+    for (;;) {
+        if (tick_millis()-ms >= 1000) {
+            ms += 1000;
+            PORTB ^= 1;
+        }
+        if (tick_micros()-us >= 1000000) {
+            us += 1000000;
+            PORTC ^= 1;
+        }
+    }
+
+    return 0;
+}
+
+#endif /* _TICK_H_TEST_ */
+
+
+#endif /* _TICK_H_ */
@@ -1,8 +1,8 @@
 /*
  * Timer/counter2
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -96,7 +96,7 @@
 #define timer2_ovf_wait()       wait_set_bit(TIFR, TOV2)  /* wait to overflow signal */
 #define timer2_di()             timer2_set(TIMER2_CK_STOP)  /* disable */
 #define timer2_force_out_cmp()  sbi(TCCR2, FOC2)            /* force change OC2 - not suport in PWM modes */
-#define timer2_update_wait()    wait_set_mask(ASSR, b1(TCN2UB)|b1(OCR2UB)|b1(TCR2UB))  /* wait to registers update busy */
+#define timer2_update_wait()    wait_clear_mask(ASSR, b1(TCN2UB)|b1(OCR2UB)|b1(TCR2UB))  /* wait to end of registers update (RTC mode) */
 #define timer2_value_get()      in(TCNT2)                   /* read counted value */
 
 
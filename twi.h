@@ -1,8 +1,8 @@
 /*
  * Two wire serial interface
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 /*
@@ -58,6 +58,35 @@
 /* general call recognition enable (twi_addr) */
 #define TWI_ADDR_GENERAL  b1(TWGCE)
 
+/* TWI status codes (twi_status) */
+#define TWI_ST_START                  0x08  /* start condition transmitted (master) */
+#define TWI_ST_REP_START              0x10  /* repeated start condition transmitted (master) */
+#define TWI_ST_MT_SLA_ACK             0x18  /* SLA+W transmitted - ACK received (master transmitter) */
+#define TWI_ST_MT_SLA_NACK            0x20  /* SLA+W transmitted - NACK received (master transmitter) */
+#define TWI_ST_MT_DATA_ACK            0x28  /* data transmitted - ACK received (master transmitter) */
+#define TWI_ST_MT_DATA_NACK           0x30  /* data transmitted - NACK received (master transmitter) */
+#define TWI_ST_ARB_LOST               0x38  /* arbitration lost in SLA+R/W or data (master) */
+#define TWI_ST_MR_SLA_ACK             0x40  /* SLA+R transmitted - ACK received (master receiver) */
+#define TWI_ST_MR_SLA_NACK            0x48  /* SLA+R transmitted - NACK received (master receiver) */
+#define TWI_ST_MR_DATA_ACK            0x50  /* data received - ACK returned (master receiver) */
+#define TWI_ST_MR_DATA_NACK           0x58  /* data received - NACK returned (master receiver) */
+#define TWI_ST_SR_SLA_ACK             0x60  /* own SLA+W received - ACK returned (slave receiver) */
+#define TWI_ST_SR_ARB_LOST_SLA_ACK    0x68  /* arbitration lost as master - own SLA+W received (slave receiver) */
+#define TWI_ST_SR_GCALL_ACK           0x70  /* general call received - ACK returned (slave receiver) */
+#define TWI_ST_SR_ARB_LOST_GCALL_ACK  0x78  /* arbitration lost as master - general call received (slave receiver) */
+#define TWI_ST_SR_DATA_ACK            0x80  /* data received - ACK returned (slave receiver) */
+#define TWI_ST_SR_DATA_NACK           0x88  /* data received - NACK returned (slave receiver) */
+#define TWI_ST_SR_GCALL_DATA_ACK      0x90  /* general call data received - ACK returned (slave receiver) */
+#define TWI_ST_SR_GCALL_DATA_NACK     0x98  /* general call data received - NACK returned (slave receiver) */
+#define TWI_ST_SR_STOP                0xA0  /* stop or repeated start received (slave receiver) */
+#define TWI_ST_ST_SLA_ACK             0xA8  /* own SLA+R received - ACK returned (slave transmitter) */
+#define TWI_ST_ST_ARB_LOST_SLA_ACK    0xB0  /* arbitration lost as master - own SLA+R received (slave transmitter) */
+#define TWI_ST_ST_DATA_ACK            0xB8  /* data transmitted - ACK received (slave transmitter) */
+#define TWI_ST_ST_DATA_NACK           0xC0  /* data transmitted - NACK received (slave transmitter) */
+#define TWI_ST_ST_LAST_DATA           0xC8  /* last data transmitted - ACK received (slave transmitter) */
+#define TWI_ST_NO_INFO                0xF8  /* no relevant state information (TWINT=0) */
+#define TWI_ST_BUS_ERROR              0x00  /* bus error by illegal start or stop condition */
+
 /* TWI macros */
 #define twi_set(cnt)         {out(TWSR, (cnt)&0xFF); out(TWCR, (cnt)>>8);}  /* setup */
 #define twi_signal(sgn)      smi(TWCR, sgn)             /* enable signals */
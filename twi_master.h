@@ -0,0 +1,289 @@
+/*
+ * Interrupt driven TWI master
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Setup bitrate with twi_set() and twi_bitrate(), call twi_master_en() and
+ *   forward the TWI interrupt to the master handler:
+ *
+ *     ISR_TWI() {twi_master_isr();}
+ *
+ *   Messages are queued by twi_master_write(), twi_master_read() and
+ *   twi_master_write_read() (write then repeated start and read) and are run
+ *   one after other by the ISR, so the main loop is free during transfers.
+ *   Message status is TWI_MSG_WAIT until done, then the optional done callback
+ *   is called from ISR (keep it short).
+ *
+ *   Message memory and buffers must be valid until done. Address NACK (busy
+ *   device, e.g. eeprom write cycle) and arbitration lost are retried up to
+ *   TWI_MASTER_RETRY times.
+ */
+
+
+#ifndef _TWI_MASTER_H_
+#define _TWI_MASTER_H_ 1
+
+
+#include "util.h"
+#include "twi.h"
+
+
+/* TWI master options */
+#ifndef TWI_MASTER_QUEUE
+#define TWI_MASTER_QUEUE  4  /* queued messages (power of two) */
+#endif /* TWI_MASTER_QUEUE */
+#ifndef TWI_MASTER_RETRY
+#define TWI_MASTER_RETRY  3  /* retries on address NACK and arbitration lost */
+#endif /* TWI_MASTER_RETRY */
+
+/* TWI message status (twi_msg.status) */
+#define TWI_MSG_WAIT   0  /* queued or in transfer */
+#define TWI_MSG_OK     1  /* done */
+#define TWI_MSG_NACK   2  /* slave address NACK (after retries) */
+#define TWI_MSG_DNACK  3  /* data NACK by slave */
+#define TWI_MSG_ARB    4  /* arbitration lost (after retries) */
+#define TWI_MSG_ERROR  5  /* bus error */
+
+
+/* TWI message */
+typedef struct twi_msg {
+    uint8_t addr;                      /* 7bit slave address */
+    uint8_t wlen;                      /* write length */
+    uint8_t rlen;                      /* read length */
+    volatile uint8_t status;           /* TWI_MSG_* */
+    const uint8_t *wbuf;               /* write data */
+    uint8_t *rbuf;                     /* read data */
+    void (*done)(struct twi_msg *msg); /* done callback (from ISR) or 0 */
+} twi_msg_t;
+
+
+/* TWI master state */
+static struct {
+    FIFO(twi_msg_t *, TWI_MASTER_QUEUE) queue;  /* producer: main - consumer: ISR */
+    twi_msg_t *msg;                             /* current message (ISR only) */
+    uint8_t idx;                                /* current byte (ISR only) */
+    uint8_t retry;                              /* remain retries (ISR only) */
+    volatile uint8_t busy;                      /* ISR is running messages */
+} _twi_master __attribute__((unused));
+
+
+/* TWI master control values (TWCR) */
+#define _TWI_MASTER_CR(x)    (b1(TWINT)|b1(TWEN)|b1(TWIE)|(x))
+#define _TWI_MASTER_NEXT     _TWI_MASTER_CR(0)                      /* continue */
+#define _TWI_MASTER_ACK      _TWI_MASTER_CR(b1(TWEA))               /* continue and ACK received data */
+#define _TWI_MASTER_START    _TWI_MASTER_CR(b1(TWSTA))              /* (repeated) start */
+#define _TWI_MASTER_RESTART  _TWI_MASTER_CR(b1(TWSTO)|b1(TWSTA))    /* stop then start */
+#define _TWI_MASTER_STOP     (b1(TWINT)|b1(TWEN)|b1(TWSTO))         /* stop and idle */
+
+
+/* TWI master macros */
+#define twi_master_en()    {fifo_clear(_twi_master.queue); _twi_master.msg = 0; _twi_master.busy = 0; twi_en();}  /* reset queue and enable */
+#define twi_master_busy()  (_twi_master.busy)                     /* messages in transfer */
+#define twi_master_wait()  {while (twi_master_busy());}           /* wait to all messages done */
+#define twi_msg_done(msg)  ((msg)->status != TWI_MSG_WAIT)        /* message is done */
+#define twi_msg_wait(msg)  {while (!twi_msg_done(msg));}          /* wait to message done */
+
+
+/* queue message, return 0 if queue is full */
+static inline uint8_t twi_master_submit(twi_msg_t *msg) {
+    msg->status = TWI_MSG_WAIT;
+    if (!fifo_push(_twi_master.queue, msg))
+        return 0;
+    if (!_twi_master.busy) {
+        _twi_master.busy = 1;
+        wait_clear_bit(TWCR, TWSTO);  /* last stop condition */
+        out(TWCR, _TWI_MASTER_START);
+    }
+    return 1;
+}
+
+/* queue write message */
+static inline uint8_t twi_master_write(twi_msg_t *msg, uint8_t adr, const void *buf, uint8_t len, void (*done)(twi_msg_t *)) {
+    msg->addr = adr;
+    msg->wbuf = (const uint8_t *)buf;
+    msg->wlen = len;
+    msg->rbuf = 0;
+    msg->rlen = 0;
+    msg->done = done;
+    return twi_master_submit(msg);
+}
+
+/* queue read message */
+static inline uint8_t twi_master_read(twi_msg_t *msg, uint8_t adr, void *buf, uint8_t len, void (*done)(twi_msg_t *)) {
+    msg->addr = adr;
+    msg->wbuf = 0;
+    msg->wlen = 0;
+    msg->rbuf = (uint8_t *)buf;
+    msg->rlen = len;
+    msg->done = done;
+    return twi_master_submit(msg);
+}
+
+/* queue write then repeated start and read message (e.g. register address then data) */
+static inline uint8_t twi_master_write_read(twi_msg_t *msg, uint8_t adr, const void *wbuf, uint8_t wlen, void *rbuf, uint8_t rlen, void (*done)(twi_msg_t *)) {
+    msg->addr = adr;
+    msg->wbuf = (const uint8_t *)wbuf;
+    msg->wlen = wlen;
+    msg->rbuf = (uint8_t *)rbuf;
+    msg->rlen = rlen;
+    msg->done = done;
+    return twi_master_submit(msg);
+}
+
+/* finish current message and start next or stop */
+static inline void _twi_master_finish(uint8_t sts) {
+    twi_msg_t *msg = _twi_master.msg;
+
+    _twi_master.msg = 0;
+    msg->status = sts;
+    if (msg->done)
+        msg->done(msg);
+    if (fifo_empty(_twi_master.queue)) {
+        out(TWCR, _TWI_MASTER_STOP);
+        _twi_master.busy = 0;
+    } else {
+        out(TWCR, _TWI_MASTER_RESTART);
+    }
+}
+
+/* retry current message or finish with error */
+static inline void _twi_master_retry(uint8_t sts, uint8_t cr) {
+    if (_twi_master.retry) {
+        _twi_master.retry--;
+        out(TWCR, cr);
+    } else {
+        _twi_master_finish(sts);
+    }
+}
+
+/* TWI master handler (call from ISR_TWI) */
+static inline void twi_master_isr(void) {
+    twi_msg_t *msg = _twi_master.msg;
+
+    switch (twi_status()) {
+    case TWI_ST_START:
+        if (!msg) {
+            if (!fifo_pop(_twi_master.queue, &msg)) {
+                out(TWCR, _TWI_MASTER_STOP);
+                _twi_master.busy = 0;
+                break;
+            }
+            _twi_master.msg = msg;
+            _twi_master.retry = TWI_MASTER_RETRY;
+        }
+        _twi_master.idx = 0;
+        twi_data((msg->addr << 1) | ((msg->wlen || !msg->rlen)? 0: 1));  /* SLA+W (write or probe) or SLA+R */
+        out(TWCR, _TWI_MASTER_NEXT);
+        break;
+
+    case TWI_ST_REP_START:
+        _twi_master.idx = 0;
+        twi_data((msg->addr << 1) | 1);  /* SLA+R */
+        out(TWCR, _TWI_MASTER_NEXT);
+        break;
+
+    case TWI_ST_MT_SLA_ACK:
+    case TWI_ST_MT_DATA_ACK:
+        if (_twi_master.idx < msg->wlen) {
+            twi_data(msg->wbuf[_twi_master.idx++]);
+            out(TWCR, _TWI_MASTER_NEXT);
+        } else if (msg->rlen) {
+            out(TWCR, _TWI_MASTER_START);  /* repeated start for read */
+        } else {
+            _twi_master_finish(TWI_MSG_OK);
+        }
+        break;
+
+    case TWI_ST_MT_SLA_NACK:
+    case TWI_ST_MR_SLA_NACK:
+        _twi_master_retry(TWI_MSG_NACK, _TWI_MASTER_RESTART);
+        break;
+
+    case TWI_ST_MT_DATA_NACK:
+        _twi_master_finish(TWI_MSG_DNACK);
+        break;
+
+    case TWI_ST_ARB_LOST:
+        _twi_master_retry(TWI_MSG_ARB, _TWI_MASTER_START);  /* start when bus is free */
+        break;
+
+    case TWI_ST_MR_SLA_ACK:
+        out(TWCR, (msg->rlen > 1)? _TWI_MASTER_ACK: _TWI_MASTER_NEXT);  /* NACK last byte */
+        break;
+
+    case TWI_ST_MR_DATA_ACK:
+        msg->rbuf[_twi_master.idx++] = twi_data_get();
+        out(TWCR, (_twi_master.idx+1 < msg->rlen)? _TWI_MASTER_ACK: _TWI_MASTER_NEXT);
+        break;
+
+    case TWI_ST_MR_DATA_NACK:
+        msg->rbuf[_twi_master.idx] = twi_data_get();
+        _twi_master_finish(TWI_MSG_OK);
+        break;
+
+    case TWI_ST_NO_INFO:
+        break;
+
+    default:  /* TWI_ST_BUS_ERROR and slave states */
+        if (msg) {
+            _twi_master_finish(TWI_MSG_ERROR);
+        } else {
+            out(TWCR, _TWI_MASTER_STOP);
+            _twi_master.busy = 0;
+        }
+        break;
+    }
+}
+
+
+#ifdef _TWI_MASTER_H_TEST_
+
+/* read 8 bytes from 24Cxx eeprom (0x50) while main loop counts on PORTB */
+/* PORTC shows message status */
+
+uint8_t reg[2] = {0, 0};
+uint8_t data[8];
+twi_msg_t msg;
+volatile uint8_t done = 0;
+
+void on_done(twi_msg_t *m) {
+    done = m->status;
+}
+
+int main(void) {
+    uint8_t count = 0;
+
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    twi_set(TWI_CK_DIV1);
+    twi_bitrate(100);
+    twi_master_en();
+    sei();
+
+    twi_master_write_read(&msg, 0x50, reg, sizeof(reg), data, sizeof(data), on_done);
+
+    while (!done)
+        PORTB = ++count;  /* CPU is free during transfer */
+    PORTC = done;
+
+    for (;;);
+
+    return 0;
+}
+
+ISR_TWI() {
+    twi_master_isr();
+}
+
+#endif /* _TWI_MASTER_H_TEST_ */
+
+
+#endif /* _TWI_MASTER_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Interrupt driven TWI slave register map
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call twi_slave_en() with own address and a register array, and forward
+ *   the TWI interrupt to the slave handler:
+ *
+ *     ISR_TWI() {twi_slave_isr();}
+ *
+ *   Master write: first byte is register address, next bytes are written to
+ *   registers with auto increment (wrap to 0 after last register). Only bits
+ *   set in per register write mask are changed (mask 0x00 is read only).
+ *   Master read: registers are sent from current address with auto increment.
+ *   General call (TWI_ADDR_GENERAL) writes are handled like own address
+ *   writes, so a master can set registers on all slaves at once.
+ *
+ *   Handler has no loop and no callback, every state is a few loads and
+ *   stores, so worst case ISR time is constant. At 400KHz one byte takes 9
+ *   SCL clocks (22.5us, 360 cycles at 16MHz) and SCL is stretched while ISR
+ *   runs. _TWI_SLAVE_H_TEST_ measures max ISR cycles.
+ */
+
+
+#ifndef _TWI_SLAVE_H_
+#define _TWI_SLAVE_H_ 1
+
+
+#include "util.h"
+#include "twi.h"
+
+
+/* TWI slave state */
+static struct {
+    volatile uint8_t *regs;    /* register array */
+    const uint8_t *wmask;      /* write mask per register */
+    uint8_t size;              /* number of registers */
+    uint8_t ptr;               /* current register address */
+    uint8_t first;             /* next received byte is register address */
+    volatile uint8_t written;  /* registers changed by master (cleared by main) */
+} _twi_slave __attribute__((unused));
+
+
+/* TWI slave control values (TWCR) */
+#define _TWI_SLAVE_ACK    (b1(TWINT)|b1(TWEA)|b1(TWEN)|b1(TWIE))            /* continue and ACK */
+#define _TWI_SLAVE_RESET  (b1(TWINT)|b1(TWEA)|b1(TWSTO)|b1(TWEN)|b1(TWIE))  /* recover from bus error */
+
+
+/* TWI slave macros */
+#define twi_slave_di()             out(TWCR, 0)                /* disable */
+#define twi_slave_written()        (_twi_slave.written)        /* check registers changed by master */
+#define twi_slave_written_clear()  {_twi_slave.written = 0;}   /* clear changed flag */
+#define twi_slave_addr_get()       (_twi_slave.ptr)            /* current register address */
+
+
+/* enable slave with 7bit address (gcl: TWI_ADDR_GENERAL or 0) and n registers */
+static inline void twi_slave_en(uint8_t adr, uint8_t gcl, volatile uint8_t *regs, const uint8_t *wmask, uint8_t n) {
+    _twi_slave.regs = regs;
+    _twi_slave.wmask = wmask;
+    _twi_slave.size = n;
+    _twi_slave.ptr = 0;
+    _twi_slave.first = 1;
+    _twi_slave.written = 0;
+    twi_addr((adr << 1) | gcl);
+    out(TWCR, b1(TWEA)|b1(TWEN)|b1(TWIE));
+}
+
+/* TWI slave handler (call from ISR_TWI) */
+static inline void twi_slave_isr(void) {
+    uint8_t ptr = _twi_slave.ptr;
+    uint8_t dta;
+
+    switch (twi_status()) {
+    case TWI_ST_SR_SLA_ACK:
+    case TWI_ST_SR_ARB_LOST_SLA_ACK:
+    case TWI_ST_SR_GCALL_ACK:
+    case TWI_ST_SR_ARB_LOST_GCALL_ACK:
+        _twi_slave.first = 1;
+        break;
+
+    case TWI_ST_SR_DATA_ACK:
+    case TWI_ST_SR_GCALL_DATA_ACK:
+        dta = twi_data_get();
+        if (_twi_slave.first) {
+            _twi_slave.first = 0;
+            _twi_slave.ptr = (dta < _twi_slave.size)? dta: 0;
+        } else {
+            uint8_t msk = _twi_slave.wmask[ptr];
+            _twi_slave.regs[ptr] = (_twi_slave.regs[ptr] & ~msk) | (dta & msk);
+            _twi_slave.written = 1;
+            _twi_slave.ptr = (ptr+1 < _twi_slave.size)? ptr+1: 0;
+        }
+        break;
+
+    case TWI_ST_ST_SLA_ACK:
+    case TWI_ST_ST_ARB_LOST_SLA_ACK:
+    case TWI_ST_ST_DATA_ACK:
+        twi_data(_twi_slave.regs[ptr]);
+        _twi_slave.ptr = (ptr+1 < _twi_slave.size)? ptr+1: 0;
+        break;
+
+    case TWI_ST_BUS_ERROR:
+        out(TWCR, _TWI_SLAVE_RESET);
+        return;
+
+    default:  /* TWI_ST_SR_STOP, TWI_ST_ST_DATA_NACK, TWI_ST_ST_LAST_DATA and NACK states */
+        _twi_slave.first = 1;
+        break;
+    }
+    out(TWCR, _TWI_SLAVE_ACK);
+}
+
+
+#ifdef _TWI_SLAVE_H_TEST_
+
+/* slave 0x20 with 8 registers: 0,1 read only (id, PINA), 2 writes PORTC, 3~7 read/write */
+/* PORTB shows max ISR cycles (timer1 at F_CPU/1) */
+
+volatile uint8_t regs[8] = {0xA5};
+const uint8_t wmask[8] = {0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+volatile uint8_t cycles = 0;
+
+int main(void) {
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    TCCR1B = b1(CS10);
+    twi_slave_en(0x20, TWI_ADDR_GENERAL, regs, wmask, sizeof(regs));
+    sei();
+
+    for (;;) {
+        regs[1] = PINA;
+        if (twi_slave_written()) {
+            twi_slave_written_clear();
+            PORTC = regs[2];
+        }
+        PORTB = cycles;
+    }
+
+    return 0;
+}
+
+ISR_TWI() {
+    uint16_t t = in(TCNT1);
+
+    twi_slave_isr();
+    t = in(TCNT1)-t;
+    if (t > cycles)
+        cycles = t;
+}
+
+#endif /* _TWI_SLAVE_H_TEST_ */
+
+
+#endif /* _TWI_SLAVE_H_ */
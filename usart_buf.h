@@ -0,0 +1,205 @@
+/*
+ * Interrupt driven buffered USART
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Setup the USART with usart_set() and usart_baud() as usual, then call
+ *   usart_buf_en() and forward the USART interrupts to the buffer handlers:
+ *
+ *     ISR_USART_RXC()   {usart_buf_rxc();}
+ *     ISR_USART_EMPTY() {usart_buf_empty();}
+ *
+ *   Transmit bytes are queued by usart_buf_write() and usart_buf_write_block()
+ *   and sent from the data register empty interrupt. Received bytes are queued
+ *   by the receive complete interrupt and read by usart_buf_read().
+ *
+ *   Buffers are util.h FIFOs with at most 128 bytes, so 8bit indices and no
+ *   interrupt disable needed. Only 8bit data frames are buffered (not
+ *   USART_DATA_9BIT).
+ */
+
+
+#ifndef _USART_BUF_H_
+#define _USART_BUF_H_ 1
+
+
+#include "util.h"
+#include "usart.h"
+
+
+/* USART buffer sizes (power of two: 2,4,8,...,128) */
+#ifndef USART_BUF_TX_SIZE
+#define USART_BUF_TX_SIZE  64  /* transmit buffer size */
+#endif /* USART_BUF_TX_SIZE */
+#ifndef USART_BUF_RX_SIZE
+#define USART_BUF_RX_SIZE  64  /* receive buffer size */
+#endif /* USART_BUF_RX_SIZE */
+
+#if (USART_BUF_TX_SIZE & (USART_BUF_TX_SIZE-1)) || USART_BUF_TX_SIZE < 2 || USART_BUF_TX_SIZE > 128
+#error "USART_BUF_TX_SIZE must be power of two (2 ~ 128)"
+#endif
+#if (USART_BUF_RX_SIZE & (USART_BUF_RX_SIZE-1)) || USART_BUF_RX_SIZE < 2 || USART_BUF_RX_SIZE > 128
+#error "USART_BUF_RX_SIZE must be power of two (2 ~ 128)"
+#endif
+
+
+/* USART buffer state */
+static struct {
+    FIFO(uint8_t, USART_BUF_TX_SIZE) tx;  /* producer: usart_buf_write - consumer: usart_buf_empty */
+    FIFO(uint8_t, USART_BUF_RX_SIZE) rx;  /* producer: usart_buf_rxc - consumer: usart_buf_read */
+    volatile uint8_t overrun;             /* lost received bytes (hardware over run and full buffer) */
+    volatile uint8_t sent;                /* byte loaded since last flush (TXC will be set) */
+} _usart_buf __attribute__((unused));
+
+
+/* USART buffer macros */
+#define usart_buf_en()             {fifo_clear(_usart_buf.tx); fifo_clear(_usart_buf.rx); _usart_buf.overrun = 0; _usart_buf.sent = 0; usart_signal(USART_INT_RXC);}  /* reset buffers and enable receive signal */
+#define usart_buf_di()             cmi(UCSRB, USART_INT_RXC|USART_INT_EMPTY)  /* disable buffer signals */
+#define usart_buf_available()      ((uint8_t)fifo_count(_usart_buf.rx))      /* received bytes in buffer */
+#define usart_buf_pending()        ((uint8_t)fifo_count(_usart_buf.tx))      /* transmit bytes in buffer */
+#define usart_buf_free()           ((uint8_t)fifo_space(_usart_buf.tx))      /* free space in transmit buffer */
+#define usart_buf_overrun()        (_usart_buf.overrun)                      /* lost received bytes counter */
+#define usart_buf_overrun_clear()  {_usart_buf.overrun = 0;}                 /* clear lost received bytes counter */
+
+
+/* queue one byte for transmit, return 0 if buffer is full */
+static inline uint8_t usart_buf_write(uint8_t dta) {
+    if (!fifo_push(_usart_buf.tx, dta))
+        return 0;
+    usart_signal(USART_INT_EMPTY);
+    return 1;
+}
+
+/* queue block of bytes for transmit, return number of queued bytes */
+static inline uint8_t usart_buf_write_block(const void *buf, uint8_t len) {
+    uint8_t n = fifo_push_block(_usart_buf.tx, (const uint8_t *)buf, len);
+
+    if (n)
+        usart_signal(USART_INT_EMPTY);
+    return n;
+}
+
+/* wait to transmit last frame (returns at once if nothing was sent) */
+static inline void usart_buf_flush(void) {
+    while (usart_buf_pending());
+    if (_usart_buf.sent) {
+        usart_empty_wait();
+        usart_tx_wait();
+        _usart_buf.sent = 0;
+    }
+}
+
+/* read one received byte, return -1 if buffer is empty */
+static inline int16_t usart_buf_read(void) {
+    uint8_t dta;
+
+    if (!fifo_pop(_usart_buf.rx, &dta))
+        return -1;
+    return dta;
+}
+
+/* read block of received bytes, return number of readed bytes */
+static inline uint8_t usart_buf_read_block(void *buf, uint8_t len) {
+    return fifo_pop_block(_usart_buf.rx, (uint8_t *)buf, len);
+}
+
+/* receive complete handler (call from ISR_USART_RXC) */
+static inline void usart_buf_rxc(void) {
+    uint8_t dor = usart_data_overrun();  /* DOR is valid until UDR read */
+    uint8_t dta = in(UDR);
+
+    if (dor)
+        _usart_buf.overrun++;
+    if (!fifo_push(_usart_buf.rx, dta))
+        _usart_buf.overrun++;
+}
+
+/* data register empty handler (call from ISR_USART_EMPTY) */
+static inline void usart_buf_empty(void) {
+    uint8_t dta;
+
+    if (fifo_pop(_usart_buf.tx, &dta)) {
+        sbi(UCSRA, TXC);  /* clear by write one, set after last frame */
+        out(UDR, dta);
+        _usart_buf.sent = 1;
+    }
+    if (fifo_empty(_usart_buf.tx))
+        cmi(UCSRB, USART_INT_EMPTY);  /* nothing to send */
+}
+
+
+#ifdef _USART_BUF_H_TEST_
+
+/* loopback test: connect TXD to RXD, timer0 overflow ISR of 200 cycles is load (about 10% at F_CPU/8) */
+/* PORTB: lost bytes, PORTC: received bytes per second/64 (180 at 115200 8N1), PORTA: percent of bus rate */
+
+#include "timer0.h"
+#include "timer1.h"
+
+int main(void) {
+    uint8_t block[32];
+    uint8_t tx = 0, rx = 0, lost = 0, i, n;
+    uint16_t bytes = 0;
+    int16_t c;
+
+    PORTB = 0;
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRA = ~0;
+
+    usart_set(USART_RX | USART_TX | USART_REG_SELECT | USART_DATA_8BIT | USART_BAUD_DOUBLE);
+    usart_baud(USART_BAUD_115200/2);  /* 115200 with double speed */
+    usart_buf_en();
+    usart_buf_flush();  /* nothing sent, returns at once */
+    timer0_set(TIMER0_MODE_NORMAL | TIMER0_CK_DIV8);
+    timer0_signal(TIMER0_INT_OVF);
+    timer1_set(TIMER1_MODE_NORMAL | TIMER1_CK_DIV1024);
+    timer1_value(0);
+    sei();
+
+    for (;;) {
+        for (i = 0; i < sizeof(block); i++)
+            block[i] = tx+i;
+        n = usart_buf_write_block(block, sizeof(block));
+        tx += n;
+
+        while ((c = usart_buf_read()) >= 0) {
+            if ((uint8_t)c != rx)
+                lost++;
+            rx = c+1;
+            bytes++;
+        }
+
+        if (timer1_value_get() >= F_CPU/1024) {  /* one second */
+            timer1_value(0);
+            PORTC = bytes >> 6;
+            PORTA = (uint32_t)bytes*100/11520;
+            bytes = 0;
+        }
+        PORTB = lost+usart_buf_overrun();
+    }
+
+    return 0;
+}
+
+ISR_USART_RXC() {
+    usart_buf_rxc();
+}
+
+ISR_USART_EMPTY() {
+    usart_buf_empty();
+}
+
+ISR_TIMER0_OVF() {
+    __builtin_avr_delay_cycles(200);
+}
+
+#endif /* _USART_BUF_H_TEST_ */
+
+
+#endif /* _USART_BUF_H_ */
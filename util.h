@@ -1,8 +1,8 @@
 /*
  * Utils
- * Copyright 2013-2021 tohid.jk
+ * Copyright 2013-2026 tohid.jk
  * License GNU GPLv2
- * 2021-06-19 beta
+ * 2026-10-16 beta
  */
 
 
@@ -43,6 +43,161 @@
 #define wait_clear_mask(reg, msk)  {while (mis(reg, msk));}  /* wait until mask in io is clear */
 #define wait_set_mask(reg, msk)    {while (mic(reg, msk));}  /* wait until mask in io is set */
 
+#define barrier()  {__asm__ __volatile__ ("" ::: "memory");}  /* compiler memory barrier (keep order of memory access) */
+
+
+/*
+ * FIFO: single producer single consumer ring buffer (lock free)
+ *
+ *   Size is power of two (2 ~ 32768). Head is written only by producer and
+ *   tail only by consumer, so one side can be an ISR and the other the main
+ *   loop. Indices are free running; 8bit when size <= 128, so no interrupt
+ *   disable needed. Bigger FIFOs use 16bit indices which are loaded and stored
+ *   with interrupts off for 2 instructions (16bit access is not atomic on AVR).
+ *
+ *   C:   FIFO(uint8_t, 64) q;  fifo_push(q, x);  fifo_pop(q, &x);
+ *   C++: Fifo<uint8_t, 64> q;  q.push(x);        q.pop(x);
+ */
+
+#ifdef __cplusplus
+template <bool> struct _FifoIndex {typedef uint16_t type;};
+template <> struct _FifoIndex<true> {typedef uint8_t type;};
+#define _fifo_index_t(size)  _FifoIndex<((size) <= 128)>::type
+#else /* !__cplusplus */
+#define _fifo_index_t(size)  __typeof__(__builtin_choose_expr((size) <= 128, (uint8_t)0, (uint16_t)0))
+#endif /* __cplusplus */
+
+#define _fifo_load(idx)       ({uint16_t _fv; if (sizeof(idx) == 1) _fv = (idx); else {uint8_t _fs = in(SREG); cli(); _fv = (idx); out(SREG, _fs);} _fv;})  /* atomic index read */
+#define _fifo_store(idx, vlu) {if (sizeof(idx) == 1) (idx) = (vlu); else {uint8_t _fs = in(SREG); cli(); (idx) = (vlu); out(SREG, _fs);}}  /* atomic index write */
+
+#define FIFO(type, size)  struct {volatile _fifo_index_t(size) head, tail; type buf[size];}  /* declare FIFO of type (size: power of two) */
+
+/* FIFO macros (f: FIFO variable) */
+#define fifo_size(f)        ((uint16_t)(sizeof((f).buf)/sizeof((f).buf[0])))  /* capacity */
+#define fifo_clear(f)       {(f).head = 0; (f).tail = 0;}                     /* make empty (no producer and consumer running) */
+#define fifo_count(f)       ((uint16_t)(_fifo_load((f).head)-_fifo_load((f).tail)) & (2*fifo_size(f)-1))  /* number of elements */
+#define fifo_space(f)       (fifo_size(f)-fifo_count(f))                     /* free elements */
+#define fifo_empty(f)       (fifo_count(f) == 0)                             /* FIFO is empty */
+#define fifo_full(f)        (fifo_count(f) == fifo_size(f))                  /* FIFO is full */
+#define fifo_push(f, vlu)   ({uint8_t _fok = !fifo_full(f); if (_fok) {(f).buf[(f).head & (fifo_size(f)-1)] = (vlu); barrier(); _fifo_store((f).head, (f).head+1);} _fok;})  /* add element (producer), return 0 if full */
+#define fifo_pop(f, ptr)    ({uint8_t _fok = !fifo_empty(f); if (_fok) {*(ptr) = (f).buf[(f).tail & (fifo_size(f)-1)]; barrier(); _fifo_store((f).tail, (f).tail+1);} _fok;})  /* remove element (consumer), return 0 if empty */
+#define fifo_peek(f, ptr)   ({uint8_t _fok = !fifo_empty(f); if (_fok) *(ptr) = (f).buf[(f).tail & (fifo_size(f)-1)]; _fok;})  /* read next element without remove (consumer) */
+
+/* add block of elements (producer), return number of added elements */
+#define fifo_push_block(f, src, len)  ({ \
+    uint16_t _fh = (f).head, _fn = fifo_space(f), _fi; \
+    if (_fn > (uint16_t)(len)) _fn = (len); \
+    for (_fi = 0; _fi < _fn; _fi++) (f).buf[(_fh+_fi) & (fifo_size(f)-1)] = (src)[_fi]; \
+    barrier(); _fifo_store((f).head, _fh+_fn); _fn;})
+
+/* remove block of elements (consumer), return number of removed elements */
+#define fifo_pop_block(f, dst, len)  ({ \
+    uint16_t _ft = (f).tail, _fn = fifo_count(f), _fi; \
+    if (_fn > (uint16_t)(len)) _fn = (len); \
+    for (_fi = 0; _fi < _fn; _fi++) (dst)[_fi] = (f).buf[(_ft+_fi) & (fifo_size(f)-1)]; \
+    barrier(); _fifo_store((f).tail, _ft+_fn); _fn;})
+
+#ifdef __cplusplus
+/* FIFO template (same rules as FIFO macros) */
+template <typename T, uint16_t N>
+class Fifo {
+    static_assert(N >= 2 && N <= 0x8000 && !(N & (N-1)), "Fifo size must be power of two (2 ~ 32768)");
+
+public:
+    typedef typename _FifoIndex<(N <= 128)>::type index_t;
+
+    static uint16_t size() {return N;}
+    void clear() {head = 0; tail = 0;}
+    uint16_t count() const {return (uint16_t)(_fifo_load(head)-_fifo_load(tail)) & (2*N-1);}
+    uint16_t space() const {return N-count();}
+    bool empty() const {return count() == 0;}
+    bool full() const {return count() == N;}
+
+    bool push(const T &vlu) {
+        if (full())
+            return false;
+        buf[head & (N-1)] = vlu;
+        barrier();
+        _fifo_store(head, head+1);
+        return true;
+    }
+
+    bool pop(T &vlu) {
+        if (empty())
+            return false;
+        vlu = buf[tail & (N-1)];
+        barrier();
+        _fifo_store(tail, tail+1);
+        return true;
+    }
+
+    bool peek(T &vlu) const {
+        if (empty())
+            return false;
+        vlu = buf[tail & (N-1)];
+        return true;
+    }
+
+    uint16_t push(const T *src, uint16_t len) {return fifo_push_block(*this, src, len);}
+    uint16_t pop(T *dst, uint16_t len) {return fifo_pop_block(*this, dst, len);}
+
+    volatile index_t head, tail;
+    T buf[N];
+};
+#endif /* __cplusplus */
+
+
+#ifdef _UTIL_H_TEST_
+
+/* stress: timer0 overflow ISR is producer and main loop is consumer, PORTB shows lost or wrong elements */
+/* benchmark: PORTC shows CPU cycles of one fifo_push and fifo_pop pair (timer1 at F_CPU/1) */
+
+FIFO(uint8_t, 16) q;
+volatile uint8_t next = 0;
+
+int main(void) {
+    uint8_t expect = 0, error = 0, x, i;
+    uint16_t t;
+
+    PORTB = 0;
+    DDRB = ~0;
+    PORTC = 0;
+    DDRC = ~0;
+
+    fifo_clear(q);
+    TCCR1B = b1(CS10);
+    t = in(TCNT1);
+    for (i = 0; i < 100; i++) {
+        fifo_push(q, i);
+        fifo_pop(q, &x);
+    }
+    t = in(TCNT1)-t;
+    PORTC = t/100;
+
+    fifo_clear(q);
+    TCCR0 = b1(CS00);
+    TIMSK = b1(TOIE0);
+    sei();
+
+    for (;;) {
+        while (fifo_pop(q, &x)) {
+            if (x != expect)
+                error++;
+            expect = x+1;
+        }
+        PORTB = error;
+    }
+
+    return 0;
+}
+
+ISR(TIMER0_OVF_vect) {
+    if (fifo_push(q, next))
+        next++;
+}
+
+#endif /* _UTIL_H_TEST_ */
+
 
 #endif /* _UTIL_H_ */
 
@@ -0,0 +1,209 @@
+/*
+ * Watchdog task supervisor
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call wdt_sup_init() first at boot, then wdt_sup_report() gives cause of
+ *   last reset. Register tasks by wdt_sup_add(id, ticks), each task calls
+ *   wdt_sup_checkin(id) at least once per ticks supervisor ticks. Put
+ *   WDT_SUP_ISR(vect) of a periodic interrupt (e.g. TIMER1_COMPA_vect) in one
+ *   source file (file scope), then wdt_sup_en(WDT_CK_X) with watchdog
+ *   timeout longer than some ticks. Task table is static in header, so
+ *   checkins from other source files go to their own copy: keep all
+ *   wdt_sup_* calls in the source file of WDT_SUP_ISR.
+ *
+ *   Each tick counts down all tasks and feeds watchdog only if no task is
+ *   late. A late task is written to breadcrumb and watchdog is set to 15ms
+ *   to reset. If interrupts stay off (stuck ISR or cli loop) ticks stop and
+ *   watchdog resets too, breadcrumb task is WDT_SUP_NONE.
+ *
+ *   Breadcrumb is in .noinit RAM (kept over watchdog and external reset, no
+ *   eeprom write): late task, interrupted PC of last tick (word address, x2
+ *   for map file) and reset_check() flags of next boot. Power-on reset
+ *   clears it.
+ */
+
+
+#ifndef _WDT_SUP_H_
+#define _WDT_SUP_H_ 1
+
+
+#include "util.h"
+#include "other.h"
+#include "wdt.h"
+
+
+/* watchdog supervisor tasks (1 ~ 254) */
+#ifndef WDT_SUP_TASKS
+#define WDT_SUP_TASKS  8
+#endif /* WDT_SUP_TASKS */
+#if WDT_SUP_TASKS < 1 || WDT_SUP_TASKS > 254
+#error "WDT_SUP_TASKS must be 1 ~ 254"
+#endif
+
+#define WDT_SUP_NONE    0xFF    /* no late task (breadcrumb task) */
+#define _WDT_SUP_MAGIC  0x5AC3  /* breadcrumb is valid */
+
+
+/* watchdog supervisor breadcrumb */
+typedef struct {
+    uint16_t magic;  /* _WDT_SUP_MAGIC */
+    uint8_t task;    /* late task or WDT_SUP_NONE */
+    uint16_t pc;     /* interrupted PC of last tick (word address) */
+    uint8_t flags;   /* reset flags (reset_check) */
+} wdt_sup_crumb_t;
+
+
+/* breadcrumb of this run (kept over reset) */
+static wdt_sup_crumb_t _wdt_sup_crumb __attribute__((section(".noinit"), unused));
+
+/* watchdog supervisor state */
+static struct {
+    uint16_t limit[WDT_SUP_TASKS];          /* deadline ticks (0: not registered) */
+    volatile uint16_t left[WDT_SUP_TASKS];  /* remain ticks */
+    wdt_sup_crumb_t last;                   /* breadcrumb of last run */
+} _wdt_sup __attribute__((unused));
+
+
+/* watchdog supervisor macros */
+#define wdt_sup_report()  ((const wdt_sup_crumb_t *)&_wdt_sup.last)  /* cause of last reset */
+#define wdt_sup_en(cnt)   {wdt_set(cnt); wdt_en();}                  /* start watchdog (WDT_CK_X) */
+
+
+/* read reset flags and last breadcrumb, start new one (first at boot) */
+static inline void wdt_sup_init(void) {
+    uint8_t i;
+
+    _wdt_sup.last.flags = reset_check();
+    reset_clear();
+    if (_wdt_sup_crumb.magic == _WDT_SUP_MAGIC && !(_wdt_sup.last.flags & RESET_PORF)) {
+        _wdt_sup.last.task = _wdt_sup_crumb.task;
+        _wdt_sup.last.pc = _wdt_sup_crumb.pc;
+    } else {
+        _wdt_sup.last.task = WDT_SUP_NONE;
+        _wdt_sup.last.pc = 0;
+    }
+    _wdt_sup.last.magic = _WDT_SUP_MAGIC;
+
+    _wdt_sup_crumb.magic = _WDT_SUP_MAGIC;
+    _wdt_sup_crumb.task = WDT_SUP_NONE;
+    _wdt_sup_crumb.pc = 0;
+    _wdt_sup_crumb.flags = 0;
+    for (i = 0; i < WDT_SUP_TASKS; i++)
+        _wdt_sup.limit[i] = 0;
+}
+
+/* register task with deadline of ticks (1 ~ 65535) */
+static inline void wdt_sup_add(uint8_t id, uint16_t ticks) {
+    uint8_t s = in(SREG);
+
+    cli();
+    _wdt_sup.limit[id] = ticks;
+    _wdt_sup.left[id] = ticks;
+    out(SREG, s);
+}
+
+/* unregister task */
+static inline void wdt_sup_remove(uint8_t id) {
+    uint8_t s = in(SREG);
+
+    cli();
+    _wdt_sup.limit[id] = 0;
+    out(SREG, s);
+}
+
+/* task is alive, restart its deadline */
+static inline void wdt_sup_checkin(uint8_t id) {
+    uint8_t s = in(SREG);
+
+    cli();
+    _wdt_sup.left[id] = _wdt_sup.limit[id];
+    out(SREG, s);
+}
+
+/* supervisor tick (called by WDT_SUP_ISR after PC sample) */
+static inline void wdt_sup_isr(void) {
+    uint8_t i;
+
+    for (i = 0; i < WDT_SUP_TASKS; i++) {
+        if (_wdt_sup.limit[i] && !--_wdt_sup.left[i]) {
+            _wdt_sup_crumb.task = i;
+            wdt_set(b1(WDE) | WDT_CK_15MS);
+            for (;;);  /* reset by watchdog */
+        }
+    }
+    wdt_reset();
+}
+
+/* supervisor ISR (naked PC sample then C handler) */
+#define WDT_SUP_ISR(vect) \
+void __vector_wdt_sup(void) __attribute__((signal, used)); \
+ISR(vect, ISR_NAKED) { \
+    __asm__ __volatile__ ( \
+        "push r24"          "\n\t" \
+        "push r30"          "\n\t" \
+        "push r31"          "\n\t" \
+        "in r30, __SP_L__"  "\n\t" \
+        "in r31, __SP_H__"  "\n\t" \
+        "ldd r24, Z+4"      "\n\t" \
+        "sts %1, r24"       "\n\t" \
+        "ldd r24, Z+5"      "\n\t" \
+        "sts %0, r24"       "\n\t" \
+        "pop r31"           "\n\t" \
+        "pop r30"           "\n\t" \
+        "pop r24"           "\n\t" \
+        "%~jmp __vector_wdt_sup" "\n\t" \
+        :: "i" ((uint8_t *)&_wdt_sup_crumb.pc), "i" ((uint8_t *)&_wdt_sup_crumb.pc+1)); \
+} \
+void __vector_wdt_sup(void) { \
+    wdt_sup_isr(); \
+}
+
+
+#ifdef _WDT_SUP_H_TEST_
+
+/* 100Hz supervisor tick on timer1, task 0: main loop (50ms), task 1: PIND0 low checks in (1s) */
+/* PORTB: late task of last reset, PORTC: PC of last reset (low), PORTD7: last reset by watchdog */
+
+#include "timer1.h"
+
+WDT_SUP_ISR(TIMER1_COMPA_vect)
+
+int main(void) {
+    wdt_sup_init();
+
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = b1(7);
+    PORTD = b1(0);
+    PORTB = wdt_sup_report()->task;
+    PORTC = wdt_sup_report()->pc;
+    if (wdt_sup_report()->flags & RESET_WDRF)
+        sbi(PORTD, 7);
+
+    wdt_sup_add(0, 5);
+    wdt_sup_add(1, 100);
+    timer1_set(TIMER1_MODE_CTC_CMPA | TIMER1_CK_DIV64);
+    timer1_compareA(F_CPU/64/100-1);
+    timer1_signal(TIMER1_INT_CMPA);
+    wdt_sup_en(WDT_CK_120MS);
+    sei();
+
+    for (;;) {
+        wdt_sup_checkin(0);
+        if (bic(PIND, 0))
+            wdt_sup_checkin(1);  /* release PIND0 for 1s: reset with task 1 */
+    }
+
+    return 0;
+}
+
+#endif /* _WDT_SUP_H_TEST_ */
+
+
+#endif /* _WDT_SUP_H_ */
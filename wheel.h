@@ -0,0 +1,217 @@
+/*
+ * Software timer wheel
+ * Copyright 2013-2026 tohid.jk
+ * License GNU GPLv2
+ * 2026-10-16 beta
+ */
+
+/*
+ * Usage:
+ *
+ *   Call wheel_en(hz) for a timer1 CTC tick and forward the compare match A
+ *   interrupt to the wheel, then call wheel_run() from main loop:
+ *
+ *     ISR_TIMER1_CMPA() {wheel_tick();}
+ *
+ *   Hashed timing wheel: WHEEL_SLOTS lists, a timer of d ticks is put in
+ *   slot (tick+d) with d/WHEEL_SLOTS rounds. Timer nodes are user variables
+ *   (no heap, zero initialized or WHEEL_TIMER(fn) is idle), arm and cancel
+ *   are O(1) (doubly linked list insert and unlink). ISR only counts ticks
+ *   (8bit increment), so ISR time does not depend on number of armed
+ *   timers. wheel_run() walks due slots and calls expired callbacks in main
+ *   loop; it must be called at least once per 255 ticks. Arm and cancel
+ *   only from main loop (and callbacks). Wheel is static in header (one
+ *   wheel per source file), so ISR and all users must be in one source
+ *   file.
+ */
+
+
+#ifndef _WHEEL_H_
+#define _WHEEL_H_ 1
+
+
+#include "util.h"
+#include "timer1.h"
+
+
+/* wheel slots (power of two, 2 ~ 128) */
+#ifndef WHEEL_SLOTS
+#define WHEEL_SLOTS  32
+#endif /* WHEEL_SLOTS */
+#if (WHEEL_SLOTS & (WHEEL_SLOTS-1)) || WHEEL_SLOTS < 2 || WHEEL_SLOTS > 128
+#error "WHEEL_SLOTS must be power of two (2 ~ 128)"
+#endif
+
+#define WHEEL_IDLE  0  /* timer is not armed (wheel_timer.slot, zero initialized timer is idle) */
+
+
+/* wheel timer node */
+typedef struct wheel_timer {
+    struct wheel_timer *next;            /* next in slot */
+    struct wheel_timer *prev;            /* previous in slot */
+    uint16_t rounds;                     /* remain wheel rounds */
+    uint8_t slot;                        /* slot+1 or WHEEL_IDLE */
+    void (*fn)(struct wheel_timer *tmr); /* expire callback (from wheel_run) */
+} wheel_timer_t;
+
+#define WHEEL_TIMER(fn)  {0, 0, 0, WHEEL_IDLE, fn}  /* wheel timer initializer */
+
+
+/* wheel state */
+static struct {
+    wheel_timer_t *slot[WHEEL_SLOTS];  /* timer lists */
+    wheel_timer_t *next;               /* next timer of running slot */
+    uint8_t cur;                       /* last processed tick */
+    volatile uint8_t now;              /* ticks counted by ISR */
+} _wheel __attribute__((unused));
+
+
+/* wheel macros */
+#define wheel_tick()          {_wheel.now++;}             /* tick handler (call from ISR_TIMER1_CMPA) */
+#define wheel_armed(tmr)      ((tmr)->slot != WHEEL_IDLE)  /* timer is armed */
+#define wheel_pending()       ((uint8_t)(_wheel.now-_wheel.cur))  /* ticks not processed by wheel_run */
+#define wheel_di()            timer1_di()                  /* stop tick */
+
+
+/* start tick timer (timer1 CTC) at hz, return 0 if hz is out of range */
+static inline uint8_t wheel_en(uint32_t hz) {
+    static const uint16_t tdiv[] = {1, 8, 64, 256, 1024};
+    uint32_t top;
+    uint8_t i;
+
+    for (i = 0; i < WHEEL_SLOTS; i++)
+        _wheel.slot[i] = 0;
+    _wheel.cur = _wheel.now = 0;
+    if (!hz)
+        return 0;
+    for (i = 0; i < sizeof(tdiv)/sizeof(tdiv[0]); i++) {
+        top = F_CPU/tdiv[i]/hz;
+        if (top <= 0x10000)
+            break;
+    }
+    if (i >= sizeof(tdiv)/sizeof(tdiv[0]) || top < 2)
+        return 0;
+    timer1_value(0);
+    timer1_compareA(top-1);
+    timer1_set(TIMER1_MODE_CTC_CMPA | (i+1));  /* CS12:0 = 1 ~ 5 */
+    timer1_signal(TIMER1_INT_CMPA);
+    return 1;
+}
+
+/* cancel timer (nothing if not armed) */
+static inline void wheel_cancel(wheel_timer_t *tmr) {
+    if (tmr->slot == WHEEL_IDLE)
+        return;
+    if (_wheel.next == tmr)
+        _wheel.next = tmr->next;  /* wheel_run is walking this slot */
+    if (tmr->prev)
+        tmr->prev->next = tmr->next;
+    else
+        _wheel.slot[tmr->slot-1] = tmr->next;
+    if (tmr->next)
+        tmr->next->prev = tmr->prev;
+    tmr->slot = WHEEL_IDLE;
+}
+
+/* arm (or rearm) timer to expire after ticks (1 ~ WHEEL_SLOTS*65536) */
+static inline void wheel_arm(wheel_timer_t *tmr, uint32_t ticks) {
+    uint8_t s;
+
+    wheel_cancel(tmr);
+    if (!ticks)
+        ticks = 1;
+    ticks += wheel_pending();  /* from now, not from last processed tick */
+    s = (_wheel.cur+ticks) & (WHEEL_SLOTS-1);
+    tmr->rounds = (ticks-1)/WHEEL_SLOTS;
+    tmr->slot = s+1;
+    tmr->prev = 0;
+    tmr->next = _wheel.slot[s];
+    if (tmr->next)
+        tmr->next->prev = tmr;
+    _wheel.slot[s] = tmr;
+}
+
+/* process due ticks and call expired callbacks (call from main loop) */
+static inline void wheel_run(void) {
+    wheel_timer_t *tmr;
+
+    while (_wheel.cur != _wheel.now) {
+        _wheel.cur++;
+        tmr = _wheel.slot[_wheel.cur & (WHEEL_SLOTS-1)];
+        while (tmr) {
+            _wheel.next = tmr->next;
+            if (tmr->rounds) {
+                tmr->rounds--;
+            } else {
+                wheel_cancel(tmr);
+                tmr->fn(tmr);
+            }
+            tmr = _wheel.next;
+        }
+        _wheel.next = 0;
+    }
+}
+
+
+#ifdef _WHEEL_H_TEST_
+
+/* 1KHz wheel with WHEEL_TEST_TIMERS (8, 64 or 128) timers of 1 ~ 1000ms (9 bytes each, 128 needs ATmega32) */
+/* PORTB: cycles of arm - PORTC: cycles of cancel - PORTD: max cycles of wheel_run/4 (timer0 at F_CPU/1) */
+/* ISR time is constant (8bit increment) for any number of armed timers */
+
+#ifndef WHEEL_TEST_TIMERS
+#define WHEEL_TEST_TIMERS  64
+#endif
+#if WHEEL_TEST_TIMERS > 128
+#error "WHEEL_TEST_TIMERS must be at most 128 (RAM)"
+#endif
+
+void expire(wheel_timer_t *tmr) {
+    wheel_arm(tmr, 1000);  /* periodic */
+}
+
+wheel_timer_t tmrs[WHEEL_TEST_TIMERS];
+
+int main(void) {
+    uint8_t t, run = 0;
+    uint16_t i;
+
+    DDRB = ~0;
+    DDRC = ~0;
+    DDRD = ~0;
+
+    TCCR0 = b1(CS00);
+    wheel_en(1000);
+    for (i = 0; i < WHEEL_TEST_TIMERS; i++) {
+        tmrs[i].fn = expire;
+        t = in(TCNT0);
+        wheel_arm(&tmrs[i], 1+i*7);
+        PORTB = in(TCNT0)-t;
+    }
+    t = in(TCNT0);
+    wheel_cancel(&tmrs[0]);
+    PORTC = in(TCNT0)-t;
+    wheel_arm(&tmrs[0], 1);
+    sei();
+
+    for (;;) {
+        TCNT0 = 0;
+        TIFR = b1(TOV0);
+        wheel_run();
+        t = bis(TIFR, TOV0)? 0xFF: in(TCNT0)/4;
+        if (t > run)
+            run = t;
+        PORTD = run;
+    }
+
+    return 0;
+}
+
+ISR_TIMER1_CMPA() {
+    wheel_tick();
+}
+
+#endif /* _WHEEL_H_TEST_ */
+
+
+#endif /* _WHEEL_H_ */